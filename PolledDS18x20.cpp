@@ -0,0 +1,278 @@
+/*
+Polled DS18x20 conversion scheduler. See PolledDS18x20.h.
+Same copyright and license as PolledOneWire.cpp.
+
+Each step of a cycle is a PolledOneWire operation: a queued transaction
+for the conversion (reset, Skip ROM or Match ROM, Convert T with strong
+pullup, queue_power() for the conversion time) and for addressing each
+scratchpad, and a polled_read_into() with CRC8 check for the scratchpad
+itself, or a polled_read_into() of just the temperature bytes, which the
+reset of the next step cuts short. poll() moves on to the next step when
+the bus goes idle, so it has the same delays as PolledOneWire::poll().
+*/
+
+#include "PolledDS18x20.h"
+
+
+PolledDS18x20::PolledDS18x20( PolledOneWire *ow )
+{
+	this->ow = ow;
+	status = ONEWIRE_DS18X20_IDLE;
+	continuous = false;
+	wait_ready = false;
+	full_read_every = 0;
+	cycles = 0;
+	retried = false;
+	clear();
+}
+
+void PolledDS18x20::clear()
+{
+	count = 0;
+}
+
+bool PolledDS18x20::add( const uint8_t r[8] )
+{
+	if ( count >= ONEWIRE_DS18X20_MAX_DEVICES )
+		return false;
+	if ( r[0] != 0x10 && r[0] != 0x28 && r[0] != 0x22 )
+		return false;
+	memcpy(rom[count], r, 8);
+	valid[count] = false;
+	known[count] = false;
+	count++;
+	return true;
+}
+
+//
+// Conversion time from the configuration register, as in the
+// DS18x20_Temperature example.
+//
+unsigned long PolledDS18x20::conversion_us( uint8_t i )
+{
+	if ( !known[i] || rom[i][0] == 0x10 )
+		return 750000;
+	switch ( scratchpad[i][4] & 0x60 ) {
+	case 0x00: return 93750;	// 9 bit
+	case 0x20: return 187500;	// 10 bit
+	case 0x40: return 375000;	// 11 bit
+	}
+	return 750000;				// 12 bit
+}
+
+void PolledDS18x20::start( uint8_t mode /* = ONEWIRE_DS18X20_ALL */ )
+{
+	this->mode = mode;
+	device = 0;
+	if ( !count ) {
+		cycles++;
+		return;
+	}
+	start_convert();
+}
+
+//
+// Convert T, then hold the strong pullup for the conversion time. With Skip
+// ROM all sensors convert at once, so wait for the slowest. With wait_ready
+// the time is only the limit for polled_wait_ready().
+//
+void PolledDS18x20::start_convert()
+{
+	unsigned long us = 0;
+
+	ow->queue_clear();
+	ow->queue_reset();
+	if ( mode == ONEWIRE_DS18X20_ALL ) {
+		ow->queue_skip();
+		for ( uint8_t i = 0; i < count; i++ )
+			if ( conversion_us(i) > us )
+				us = conversion_us(i);
+	} else {
+		ow->queue_select(rom[device]);
+		us = conversion_us(device);
+	}
+	if ( wait_ready ) {
+		ow->queue_write_byte(0x44);	// Convert T
+	} else {
+		ow->queue_write_byte(0x44, 1);	// Convert T, parasite power on at the end
+		ow->queue_power(us);
+	}
+	convertUs = us;
+	ow->queue_start();
+	status = ONEWIRE_DS18X20_CONVERT;
+	started();
+}
+
+void PolledDS18x20::start_select()
+{
+	ow->queue_clear();
+	ow->queue_reset();
+	ow->queue_select(rom[device]);
+	ow->queue_write_byte(0xBE);	// Read Scratchpad
+	ow->queue_start();
+	status = ONEWIRE_DS18X20_SELECT;
+	started();
+}
+
+//
+// The step's reset overran, and it hasn't been done again yet. The sensor
+// may have taken it as a power-on reset, which doesn't lose its
+// configuration, so just doing the step again is enough.
+//
+bool PolledDS18x20::overran()
+{
+	if ( ow->queue_result == ONEWIRE_QUEUE_OVERRUN && !retried ) {
+		retried = true;
+		return true;
+	}
+	retried = false;
+	return false;
+}
+
+//
+// Let the timer interrupt poll the bus if that is how it is polled.
+//
+void PolledDS18x20::started()
+{
+#if ONEWIRE_TIMER_POLL
+	ow->start_timer_poll();
+#endif
+}
+
+void PolledDS18x20::poll()
+{
+	if ( ow->poll_status ) {
+#if !ONEWIRE_TIMER_POLL
+		ow->poll();
+#endif
+		return;
+	}
+	next();
+}
+
+//
+// The bus is idle, so the current step is done. Start the next one.
+//
+void PolledDS18x20::next()
+{
+	switch ( status ) {
+	case ONEWIRE_DS18X20_CONVERT:
+		if ( overran() ) {
+			start_convert();
+			return;
+		}
+		if ( ow->queue_result != ONEWIRE_QUEUE_OK ) {
+			// Nobody there. Skip the reads this conversion was for.
+			if ( mode == ONEWIRE_DS18X20_ALL ) {
+				for ( uint8_t i = 0; i < count; i++ )
+					valid[i] = false;
+				device = count;
+			} else {
+				valid[device++] = false;
+			}
+			break;
+		}
+		if ( wait_ready ) {
+			// Sensors answer read slots with 0 until they are done. With Skip
+			// ROM that is until the slowest one is done.
+			ow->polled_wait_ready(convertUs, ONEWIRE_DS18X20_READY_INTERVAL_US);
+			status = ONEWIRE_DS18X20_WAIT;
+			started();
+			return;
+		}
+		start_select();
+		return;
+	case ONEWIRE_DS18X20_WAIT:
+		// Read the scratchpads even after a timeout; the conversion is
+		// overdue by then, and the CRC will tell if something is wrong.
+		start_select();
+		return;
+	case ONEWIRE_DS18X20_SELECT:
+		if ( overran() ) {
+			start_select();
+			return;
+		}
+		if ( ow->queue_result != ONEWIRE_QUEUE_OK ) {
+			valid[device++] = false;
+			break;
+		}
+		// The resolution is needed for raw(), so read it all at least once;
+		// a DS18S20 needs the count remain bytes every time.
+		partialRead = full_read_every > 1 && cycles % full_read_every
+			&& known[device] && rom[device][0] != 0x10;
+		if ( partialRead )
+			ow->polled_read_into(scratchpad[device], 2);
+		else
+			ow->polled_read_into(scratchpad[device], 9, ONEWIRE_CRC_8);
+		status = ONEWIRE_DS18X20_READ;
+		started();
+		return;
+	case ONEWIRE_DS18X20_READ:
+		if ( partialRead ) {
+			valid[device] = scratchpad[device][0] != 0xFF || scratchpad[device][1] != 0xFF;
+		} else {
+			valid[device] = ow->crc_ok;
+			if ( ow->crc_ok )
+				known[device] = true;
+		}
+		device++;
+		if ( device >= count && partialRead ) {
+			// Nothing else will reset the sensor out of the read
+			ow->polled_reset();
+			status = ONEWIRE_DS18X20_TERMINATE;
+			started();
+			return;
+		}
+		break;
+	case ONEWIRE_DS18X20_TERMINATE:
+		break;
+	default:
+		return;
+	}
+
+	// On to the next sensor, or the end of the cycle
+	if ( device < count ) {
+		if ( mode == ONEWIRE_DS18X20_ALL )
+			start_select();
+		else
+			start_convert();
+		return;
+	}
+	status = ONEWIRE_DS18X20_IDLE;
+	cycles++;
+	if ( continuous )
+		start(mode);
+}
+
+//
+// Temperature in 1/16 degrees C, as worked out in the DS18x20_Temperature
+// example, except that a DS18B20/DS1822 at lower resolution still counts in
+// 1/16 degrees, so its undefined low bits are cleared rather than shifted
+// out. Only meaningful if valid[i].
+//
+int16_t PolledDS18x20::raw( uint8_t i )
+{
+	uint8_t *data = scratchpad[i];
+	int16_t raw = (data[1] << 8) | data[0];
+
+	if ( rom[i][0] == 0x10 ) {
+		raw = raw << 3; // 9 bit resolution default
+		if ( data[7] == 0x10 ) {
+			// count remain gives full 12 bit resolution
+			raw = (raw & 0xFFF0) + 12 - data[6];
+		}
+	} else {
+		uint8_t cfg = (data[4] & 0x60);
+		// at lower res, the low bits are undefined, so let's zero them
+		if (cfg == 0x00) raw = raw & ~7;  // 9 bit resolution, 93.75 ms
+		else if (cfg == 0x20) raw = raw & ~3; // 10 bit res, 187.5 ms
+		else if (cfg == 0x40) raw = raw & ~1; // 11 bit res, 375 ms
+		// default is 12 bit resolution, 750 ms conversion time
+	}
+	return raw;
+}
+
+float PolledDS18x20::celsius( uint8_t i )
+{
+	return (float) raw(i) / 16.0;
+}
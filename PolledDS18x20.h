@@ -0,0 +1,95 @@
+#ifndef PolledDS18x20_h
+#define PolledDS18x20_h
+
+#include "PolledOneWire.h"
+
+// Conversion scheduler for DS18S20, DS18B20 and DS1822 temperature sensors
+// on a PolledOneWire bus, including parasite powered ones.
+//
+// start() begins a cycle: Convert T, either on all sensors at once with
+// Skip ROM or on one sensor at a time, with the strong pullup held for
+// exactly the conversion time of the sensor's resolution (93.75, 187.5,
+// 375 or 750 ms, from the configuration byte of its last scratchpad).
+// Then each scratchpad is read and CRC checked. None of it blocks: call
+// poll() while status != 0, and read the results with celsius() or raw().
+// With continuous set, a new cycle starts as soon as one finishes.
+//
+// Until a sensor's scratchpad has been read once, 750 ms is assumed.
+//
+// If all sensors are externally powered, set wait_ready: the strong pullup
+// is then not used, and the end of the conversion is found with
+// polled_wait_ready() instead, usually well before the worst case time.
+//
+// For fast sampling, set full_read_every to N > 1: DS18B20 and DS1822
+// scratchpads are then only read in full, with their CRC, every Nth cycle.
+// In the others, only the two temperature bytes are read and the read is
+// ended with a reset, which saves 56 slots less that reset (about 2.7 ms)
+// per sensor. Those bytes have no CRC; a reading is only counted as not valid if the sensor
+// didn't answer (0xFFFF).
+//
+// A conversion or scratchpad address that stops because its reset overran
+// (see PolledOneWire::overrun) is done once more before the reading is
+// counted as not valid.
+
+#ifndef ONEWIRE_DS18X20_READY_INTERVAL_US
+#define ONEWIRE_DS18X20_READY_INTERVAL_US 1000
+#endif
+
+#ifndef ONEWIRE_DS18X20_MAX_DEVICES
+#define ONEWIRE_DS18X20_MAX_DEVICES 8
+#endif
+
+class PolledDS18x20
+{
+  public:
+	PolledDS18x20( PolledOneWire *ow );
+
+	// Add a sensor found by search(). Returns false if the ROM is not a
+	// DS18x20 or there is no more room.
+	bool add( const uint8_t rom[8] );
+	void clear();
+
+	void start( uint8_t mode = 0 ); // Starts a conversion and read cycle
+#define ONEWIRE_DS18X20_ALL				0 // Convert all with Skip ROM
+#define ONEWIRE_DS18X20_EACH			1 // Convert one sensor at a time
+	void poll(); // Call this as long as status != 0
+
+	int16_t raw( uint8_t i ); // Temperature in 1/16 degrees C
+	float celsius( uint8_t i );
+
+	uint8_t status;
+#define ONEWIRE_DS18X20_IDLE			0
+#define ONEWIRE_DS18X20_CONVERT			1
+#define ONEWIRE_DS18X20_SELECT			2
+#define ONEWIRE_DS18X20_READ			3
+#define ONEWIRE_DS18X20_WAIT			4
+#define ONEWIRE_DS18X20_TERMINATE		5
+
+	bool continuous; // Start the next cycle as soon as one finishes
+	bool wait_ready; // Sensors are externally powered, poll them for the end of the conversion
+	uint8_t full_read_every; // 0 or 1: read whole scratchpads every cycle. N: only every Nth.
+	unsigned long cycles; // Completed cycles
+
+	uint8_t count;
+	uint8_t rom[ONEWIRE_DS18X20_MAX_DEVICES][8];
+	uint8_t scratchpad[ONEWIRE_DS18X20_MAX_DEVICES][9];
+	bool valid[ONEWIRE_DS18X20_MAX_DEVICES]; // Scratchpad read with a good CRC last cycle
+
+  private:
+	PolledOneWire *ow;
+	uint8_t mode;
+	uint8_t device;
+	unsigned long convertUs;
+	bool known[ONEWIRE_DS18X20_MAX_DEVICES]; // Scratchpad has been read at least once
+	bool partialRead; // Only the temperature is being read
+	bool retried; // The current step is being done again after an overrun
+
+	unsigned long conversion_us( uint8_t i );
+	void start_convert();
+	void start_select();
+	bool overran();
+	void next();
+	void started();
+};
+
+#endif
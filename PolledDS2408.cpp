@@ -0,0 +1,186 @@
+/*
+Polled DS2408 Channel-Access streaming driver. See PolledDS2408.h.
+Same copyright and license as PolledOneWire.cpp.
+
+Addressing the device is a queued transaction (reset, Match ROM,
+Channel-Access Read 0xF5 or Write 0x5A). A block of samples is then a
+polled_read_into() of 32 samples and their CRC16, checked on the fly, and
+a write is a queued write of the byte and its complement and read of the
+0xAA confirmation and PIO state. poll() moves on to the next step when the
+bus goes idle, so it has the same delays as PolledOneWire::poll().
+
+A block of 32 samples takes 34 bytes on the bus. Reading PIO Registers
+(0xF0) for each sample, as in the DS2408_Switch example, takes a reset,
+12 bytes out and 10 bytes in for every one.
+*/
+
+#include "PolledDS2408.h"
+
+#if ONEWIRE_CRC && ONEWIRE_CRC16
+
+
+PolledDS2408::PolledDS2408( PolledOneWire *ow, const uint8_t rom[8] )
+{
+	this->ow = ow;
+	memcpy(this->rom, rom, 8);
+	status = ONEWIRE_DS2408_IDLE;
+	stream = 0;
+	block_ok = false;
+	write_ok = false;
+	pio = 0;
+	blocks = 0;
+	errors = 0;
+	retried = false;
+}
+
+//
+// Queue the reset, Match ROM and Channel-Access command, unless the device
+// is already selected for that command.
+//
+void PolledDS2408::address( uint8_t command )
+{
+	ow->queue_clear();
+	if ( stream != command ) {
+		ow->queue_reset();
+		ow->queue_select(rom);
+		ow->queue_write_byte(command);
+		stream = command;
+		addressing = true;
+	} else {
+		addressing = false;
+	}
+}
+
+void PolledDS2408::read_block()
+{
+	status = ONEWIRE_DS2408_READ;
+	address(0xF5);	// Channel-Access Read
+	if ( addressing ) {
+		ow->queue_start();
+		started();
+		return;
+	}
+	read_data();
+}
+
+//
+// Read 32 samples and the CRC16. The first block's CRC also covers the
+// command byte.
+//
+void PolledDS2408::read_data()
+{
+	uint8_t command = 0xF5;
+
+	ow->polled_read_into(samples, sizeof(samples), ONEWIRE_CRC_16,
+		addressing ? PolledOneWire::crc16(&command, 1) : 0);
+	addressing = false;
+	started();
+}
+
+void PolledDS2408::write( uint8_t value )
+{
+	status = ONEWIRE_DS2408_WRITE;
+	address(0x5A);	// Channel-Access Write
+	writeBuf[0] = value;
+	writeBuf[1] = ~value;	// The device checks the complement
+	ow->queue_write(writeBuf, 2);
+	ow->queue_read(response, 2);	// 0xAA, then the PIO pin state
+	ow->queue_start();
+	started();
+}
+
+void PolledDS2408::end()
+{
+	stream = 0;
+	status = ONEWIRE_DS2408_END;
+	ow->polled_reset();
+	started();
+}
+
+//
+// The reset before the command overran, and the step hasn't been done
+// again yet. The device may have taken it as a power-on reset, so it has
+// to be addressed again.
+//
+bool PolledDS2408::overran()
+{
+	if ( ow->queue_result == ONEWIRE_QUEUE_OVERRUN && !retried ) {
+		retried = true;
+		stream = 0;
+		return true;
+	}
+	retried = false;
+	return false;
+}
+
+//
+// Let the timer interrupt poll the bus if that is how it is polled.
+//
+void PolledDS2408::started()
+{
+#if ONEWIRE_TIMER_POLL
+	ow->start_timer_poll();
+#endif
+}
+
+void PolledDS2408::poll()
+{
+	if ( ow->poll_status ) {
+#if !ONEWIRE_TIMER_POLL
+		ow->poll();
+#endif
+		return;
+	}
+	next();
+}
+
+//
+// The bus is idle, so the current step is done.
+//
+void PolledDS2408::next()
+{
+	switch ( status ) {
+	case ONEWIRE_DS2408_READ:
+		if ( addressing ) {
+			if ( overran() ) {
+				read_block();
+				return;
+			}
+			if ( ow->queue_result != ONEWIRE_QUEUE_OK ) {
+				stream = 0;
+				block_ok = false;
+				errors++;
+				break;
+			}
+			read_data();
+			return;
+		}
+		block_ok = ow->crc_ok;
+		blocks++;
+		if ( !block_ok ) {
+			// Out of step with the device, start again next time
+			stream = 0;
+			errors++;
+		}
+		break;
+	case ONEWIRE_DS2408_WRITE:
+		if ( overran() ) {
+			write(writeBuf[0]);
+			return;
+		}
+		write_ok = ow->queue_result == ONEWIRE_QUEUE_OK && response[0] == 0xAA;
+		pio = response[1];
+		if ( !write_ok ) {
+			stream = 0;
+			errors++;
+		}
+		break;
+	case ONEWIRE_DS2408_END:
+		break;
+	default:
+		return;
+	}
+	status = ONEWIRE_DS2408_IDLE;
+}
+
+#endif // ONEWIRE_CRC && ONEWIRE_CRC16
@@ -0,0 +1,74 @@
+#ifndef PolledDS2408_h
+#define PolledDS2408_h
+
+#include "PolledOneWire.h"
+
+#if ONEWIRE_CRC && ONEWIRE_CRC16
+
+// DS2408 8-channel addressable switch on a PolledOneWire bus, using the
+// Channel-Access commands in streaming mode.
+//
+// read_block() reads the next 32 samples of the PIO pins, and write()
+// sets the PIO output latches. The first call addresses the device (reset,
+// Match ROM, Channel-Access Read or Write); after that the device stays
+// selected, and each further read_block() or write() of the same kind goes
+// straight on with no reset or ROM. Switching between reading and writing,
+// an error, or end() addresses it again.
+//
+// The DS2408 sends a CRC16 after every 32 samples, covering them (and the
+// command byte, for the first block), so samples are checked a block at a
+// time: block_ok tells whether the last block's CRC was good. Each write
+// is confirmed by the device with 0xAA, and write_ok tells whether it was.
+//
+// If addressing or a write stops because its reset overran (see
+// PolledOneWire::overrun), it is done once more before it counts as an
+// error.
+//
+// None of it blocks: call poll() while status != 0. While a stream is
+// open, nothing else may use the bus; end() finishes it with a reset.
+//
+// The CRC16 checks need ONEWIRE_CRC and ONEWIRE_CRC16; without them there
+// is no PolledDS2408.
+
+class PolledDS2408
+{
+  public:
+	PolledDS2408( PolledOneWire *ow, const uint8_t rom[8] );
+
+	void read_block(); // Read the next 32 samples into samples[]
+	void write( uint8_t value ); // Set the PIO output latches, 0 = transistor on
+	void end(); // Reset the bus, ending the stream
+	void poll(); // Call this as long as status != 0
+
+	uint8_t status;
+#define ONEWIRE_DS2408_IDLE				0
+#define ONEWIRE_DS2408_READ				1
+#define ONEWIRE_DS2408_WRITE			2
+#define ONEWIRE_DS2408_END				3
+
+	uint8_t samples[34]; // 32 PIO samples, then their inverted CRC16
+	bool block_ok; // The CRC16 of the last block was good
+	bool write_ok; // The device confirmed the last write
+	uint8_t pio; // PIO pin state sampled right after the last write
+	unsigned long blocks; // Blocks read
+	unsigned long errors; // Blocks with a bad CRC16, and writes not confirmed
+
+  private:
+	PolledOneWire *ow;
+	uint8_t rom[8];
+	uint8_t stream; // Channel-Access command the device is selected for, or 0
+	bool addressing; // The Match ROM and command are in progress, rather than the data
+	uint8_t writeBuf[2];
+	uint8_t response[2];
+	bool retried; // The current step is being done again after an overrun
+
+	void address( uint8_t command );
+	void started();
+	bool overran();
+	void next();
+	void read_data();
+};
+
+#endif // ONEWIRE_CRC && ONEWIRE_CRC16
+
+#endif
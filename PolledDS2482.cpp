@@ -0,0 +1,361 @@
+/*
+Polled 1-Wire master on a DS2482 I2C bridge. See PolledDS2482.h.
+Same copyright and license as PolledOneWire.cpp.
+
+Each polled operation is one bridge command (1-Wire Reset, Write Byte,
+Read Byte, Single Bit or Triplet), and poll() only reads the status
+register once the command's own slot time has passed, so a poll that
+finds the bridge still busy costs one short I2C read and one that
+doesn't look costs nothing. Byte transfers and search go on from one
+command to the next from poll(), as in PolledOneWire.
+
+The search keeps its state in a PolledOneWireSearch, the same as
+PolledOneWire's; only the triplets are the bridge's (Maxim Application
+Note 3684).
+*/
+
+#include "PolledDS2482.h"
+
+#if !defined(ONEWIRE_HOST_SIM)
+#include <Wire.h>
+#endif
+
+// Bridge commands
+#define DS2482_CMD_DEVICE_RESET		0xF0
+#define DS2482_CMD_SET_READ_PTR		0xE1
+#define DS2482_CMD_WRITE_CONFIG		0xD2
+#define DS2482_CMD_CHANNEL_SELECT	0xC3
+#define DS2482_CMD_1WIRE_RESET		0xB4
+#define DS2482_CMD_1WIRE_SINGLE_BIT	0x87
+#define DS2482_CMD_1WIRE_WRITE_BYTE	0xA5
+#define DS2482_CMD_1WIRE_READ_BYTE	0x96
+#define DS2482_CMD_1WIRE_TRIPLET	0x78
+
+// Read pointer codes
+#define DS2482_REG_DATA				0xE1
+#define DS2482_REG_CONFIG			0xC3
+
+// Status and configuration bits
+#define DS2482_STATUS_1WB			0x01
+#define DS2482_STATUS_PPD			0x02
+#define DS2482_STATUS_SD			0x04
+#define DS2482_STATUS_RST			0x10
+#define DS2482_STATUS_SBR			0x20
+#define DS2482_STATUS_TSB			0x40
+#define DS2482_STATUS_DIR			0x80
+#define DS2482_CONFIG_APU			0x01
+#define DS2482_CONFIG_SPU			0x04
+
+// How long the bridge takes over each command at standard speed, us
+#define DS2482_RESET_US				1148
+#define DS2482_SLOT_US				73
+
+// DS2482-800 channel select codes, and what the channel register reads back
+static const uint8_t channelCode[8] = { 0xF0, 0xE1, 0xD2, 0xC3, 0xB4, 0xA5, 0x96, 0x87 };
+static const uint8_t channelRead[8] = { 0xB8, 0xB1, 0xAA, 0xA3, 0x9C, 0x95, 0x8E, 0x87 };
+
+
+PolledDS2482::PolledDS2482( uint8_t address /* = 0x18 */ )
+{
+	this->address = address;
+	config = DS2482_CONFIG_APU;
+	command = 0;
+	poll_status = ONEWIRE_POLLSTAT_NONE;
+	bridge_ok = false;
+	reset_result = false;
+	short_detected = false;
+#if ONEWIRE_SEARCH
+	reset_search();
+#endif
+}
+
+//
+// One I2C write of a command and, if len is 2, its argument. Any failure
+// abandons the operation in progress.
+//
+bool PolledDS2482::bridge_write( uint8_t b0, uint8_t b1, uint8_t len )
+{
+	Wire.beginTransmission(address);
+	Wire.write(b0);
+	if ( len > 1 )
+		Wire.write(b1);
+	if ( Wire.endTransmission() == 0 )
+		return true;
+	bridge_ok = false;
+	poll_status = ONEWIRE_POLLSTAT_NONE;
+	return false;
+}
+
+//
+// Read the register the read pointer is on.
+//
+bool PolledDS2482::bridge_read( uint8_t *b )
+{
+	if ( Wire.requestFrom(address, (uint8_t) 1) == 1 ) {
+		*b = Wire.read();
+		return true;
+	}
+	bridge_ok = false;
+	poll_status = ONEWIRE_POLLSTAT_NONE;
+	return false;
+}
+
+bool PolledDS2482::begin()
+{
+	uint8_t b;
+
+	bridge_ok = true;
+	poll_status = ONEWIRE_POLLSTAT_NONE;
+	if ( !bridge_write(DS2482_CMD_DEVICE_RESET, 0, 1) || !bridge_read(&b) )
+		return false;
+	if ( !(b & DS2482_STATUS_RST) ) {
+		bridge_ok = false;
+		return false;
+	}
+	// Active pullup, as recommended for all but the shortest lines. The
+	// upper nibble is the complement of the lower one.
+	config = DS2482_CONFIG_APU;
+	if ( !bridge_write(DS2482_CMD_WRITE_CONFIG, config | ((uint8_t) ~config << 4), 2) || !bridge_read(&b) )
+		return false;
+	bridge_ok = b == config;
+	return bridge_ok;
+}
+
+bool PolledDS2482::select_channel( uint8_t channel )
+{
+	uint8_t b;
+
+	if ( channel > 7 )
+		return false;
+	if ( !bridge_write(DS2482_CMD_CHANNEL_SELECT, channelCode[channel], 2) || !bridge_read(&b) )
+		return false;
+	return b == channelRead[channel];
+}
+
+void PolledDS2482::depower()
+{
+	// Writing the configuration without SPU ends the strong pullup
+	bridge_write(DS2482_CMD_WRITE_CONFIG, config | ((uint8_t) ~config << 4), 2);
+}
+
+//
+// Send a 1-Wire command to the bridge, and look for its end us from now.
+//
+void PolledDS2482::one_wire( uint8_t cmd, uint8_t arg, uint8_t len, unsigned int us )
+{
+	command = cmd;
+	if ( !bridge_write(cmd, arg, len) )
+		return;
+	bitNextTime = micros();
+	bitNextTime += us;
+}
+
+void PolledDS2482::polled_reset()
+{
+	poll_status |= ONEWIRE_POLLSTAT_RESET;
+	reset_result = false;
+	one_wire(DS2482_CMD_1WIRE_RESET, 0, 1, DS2482_RESET_US);
+}
+
+void PolledDS2482::polled_write( uint8_t v, uint8_t power /* = 0 */ )
+{
+	uint8_t c = config | DS2482_CONFIG_SPU;
+
+	poll_status |= ONEWIRE_POLLSTAT_WRITE;
+	// The bridge turns the strong pullup on after the next byte, and off
+	// again at the next command
+	if ( power && !bridge_write(DS2482_CMD_WRITE_CONFIG, c | ((uint8_t) ~c << 4), 2) )
+		return;
+	one_wire(DS2482_CMD_1WIRE_WRITE_BYTE, v, 2, 8 * DS2482_SLOT_US);
+}
+
+void PolledDS2482::polled_read()
+{
+	poll_status |= ONEWIRE_POLLSTAT_READ;
+	one_wire(DS2482_CMD_1WIRE_READ_BYTE, 0, 1, 8 * DS2482_SLOT_US);
+}
+
+void PolledDS2482::polled_bit( uint8_t v )
+{
+	poll_status |= ONEWIRE_POLLSTAT_READ;
+	one_wire(DS2482_CMD_1WIRE_SINGLE_BIT, v ? 0x80 : 0, 2, DS2482_SLOT_US);
+}
+
+void PolledDS2482::polled_triplet( uint8_t direction )
+{
+	poll_status |= ONEWIRE_POLLSTAT_TRIPLET;
+	triplet_result = 0;
+	one_wire(DS2482_CMD_1WIRE_TRIPLET, direction ? 0x80 : 0, 2, 3 * DS2482_SLOT_US);
+}
+
+void PolledDS2482::polled_skip()
+{
+	polled_write(0xCC);           // Skip ROM
+}
+
+void PolledDS2482::polled_select( const uint8_t rom[8] )
+{
+	writePtr = rom;
+	byteCount = 8;
+	byteIndex = 0;
+	writeBytesPower = 0;
+	poll_status |= ONEWIRE_POLLSTAT_WRITE_BYTES;
+	polled_write(0x55);           // Choose ROM, then the ROM follows from poll()
+}
+
+void PolledDS2482::polled_write_from( const uint8_t *buf, uint16_t count, bool power /* = 0 */ )
+{
+	writePtr = buf;
+	byteCount = count;
+	byteIndex = 0;
+	writeBytesPower = power;
+	poll_status |= ONEWIRE_POLLSTAT_WRITE_BYTES;
+	write_next_byte();
+}
+
+void PolledDS2482::write_next_byte()
+{
+	if ( byteIndex < byteCount ) {
+		byteIndex++;
+		// Only power the bus after the last byte
+		polled_write(writePtr[byteIndex - 1], writeBytesPower && byteIndex == byteCount);
+		return;
+	}
+	poll_status &= ~ONEWIRE_POLLSTAT_WRITE_BYTES;
+}
+
+void PolledDS2482::polled_read_into( uint8_t *buf, uint16_t count )
+{
+	if ( !count )
+		return;
+	readPtr = buf;
+	byteCount = count;
+	byteIndex = 0;
+	poll_status |= ONEWIRE_POLLSTAT_READ_BYTES;
+	polled_read();
+}
+
+#if ONEWIRE_SEARCH
+void PolledDS2482::reset_search()
+{
+	searchState.reset();
+}
+
+void PolledDS2482::target_search( uint8_t family_code )
+{
+	searchState.target(family_code);
+}
+
+void PolledDS2482::family_skip_search()
+{
+	searchState.family_skip();
+}
+
+void PolledDS2482::polled_search( bool search_mode /* = true */ )
+{
+	searchState.begin(search_mode);
+	if ( searchState.LastDeviceFlag ) {
+		// Already found the last device, no need to touch the bus.
+		search_end();
+		return;
+	}
+	poll_status |= ONEWIRE_POLLSTAT_SEARCH;
+	search_phase = ONEWIRE_SEARCHSTAT_RESET;
+	polled_reset();
+}
+
+void PolledDS2482::search_end()
+{
+	search_result = searchState.end();
+	memcpy(readWriteBuffer, searchState.ROM_NO, 8);
+	poll_status &= ~ONEWIRE_POLLSTAT_SEARCH;
+}
+#endif
+
+void PolledDS2482::poll()
+{
+	uint8_t status;
+
+	if ( !poll_status )
+		return;
+	if ( (long) ( micros() - bitNextTime ) < 0 )
+		return; // Not time yet
+	if ( !bridge_read(&status) )
+		return;
+	if ( status & DS2482_STATUS_1WB )
+		return; // Still busy, look again next poll
+
+	// The bridge command is done
+	switch ( command ) {
+	case DS2482_CMD_1WIRE_RESET:
+		reset_result = (status & DS2482_STATUS_PPD) != 0;
+		short_detected = (status & DS2482_STATUS_SD) != 0;
+		poll_status &= ~ONEWIRE_POLLSTAT_RESET;
+		break;
+	case DS2482_CMD_1WIRE_WRITE_BYTE:
+		poll_status &= ~ONEWIRE_POLLSTAT_WRITE;
+		break;
+	case DS2482_CMD_1WIRE_READ_BYTE:
+		if ( !bridge_write(DS2482_CMD_SET_READ_PTR, DS2482_REG_DATA, 2) || !bridge_read(&readWriteByte) )
+			return;
+		poll_status &= ~ONEWIRE_POLLSTAT_READ;
+		break;
+	case DS2482_CMD_1WIRE_SINGLE_BIT:
+		readWriteByte = (status & DS2482_STATUS_SBR) ? 1 : 0;
+		poll_status &= ~ONEWIRE_POLLSTAT_READ;
+		break;
+	case DS2482_CMD_1WIRE_TRIPLET:
+		if ( status & DS2482_STATUS_SBR )
+			triplet_result |= ONEWIRE_TRIPLET_ID_BIT;
+		if ( status & DS2482_STATUS_TSB )
+			triplet_result |= ONEWIRE_TRIPLET_CMP_BIT;
+		if ( status & DS2482_STATUS_DIR )
+			triplet_result |= ONEWIRE_TRIPLET_DIRECTION;
+		poll_status &= ~ONEWIRE_POLLSTAT_TRIPLET;
+		break;
+	}
+	command = 0;
+
+	// Go straight on to the next command of a longer operation
+	if ( poll_status & ONEWIRE_POLLSTAT_WRITE_BYTES ) {
+		write_next_byte();
+		return;
+	}
+	if ( poll_status & ONEWIRE_POLLSTAT_READ_BYTES ) {
+		readPtr[byteIndex++] = readWriteByte;
+		if ( byteIndex == byteCount )
+			poll_status &= ~ONEWIRE_POLLSTAT_READ_BYTES;
+		else
+			polled_read();
+		return;
+	}
+#if ONEWIRE_SEARCH
+	if ( poll_status & ONEWIRE_POLLSTAT_SEARCH ) {
+		switch ( search_phase ) {
+		case ONEWIRE_SEARCHSTAT_RESET:
+			if ( !reset_result ) {
+				search_end(); // Nobody there
+				return;
+			}
+			polled_write(searchState.command); // Issue the search command
+			search_phase = ONEWIRE_SEARCHSTAT_COMMAND;
+			return;
+		case ONEWIRE_SEARCHSTAT_COMMAND:
+			polled_triplet(searchState.direction());
+			search_phase = ONEWIRE_SEARCHSTAT_TRIPLET;
+			return;
+		case ONEWIRE_SEARCHSTAT_TRIPLET:
+			// The bridge took the way direction() gave it, next_bit()
+			// records the same one
+			if ( searchState.next_bit(triplet_result & ONEWIRE_TRIPLET_ID_BIT,
+					(triplet_result & ONEWIRE_TRIPLET_CMP_BIT) != 0) <= 1
+					&& !searchState.done() ) {
+				polled_triplet(searchState.direction());
+				return;
+			}
+			search_end(); // All 64 bits done, or no devices answered
+			return;
+		}
+	}
+#endif
+}
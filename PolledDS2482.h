@@ -0,0 +1,88 @@
+#ifndef PolledDS2482_h
+#define PolledDS2482_h
+
+#include "PolledOneWire.h"
+
+// Polled 1-Wire master on a DS2482-100 or DS2482-800 I2C bridge.
+//
+// The bridge times the 1-Wire slots itself, so there are no interrupts
+// disabled windows here at all: each polled operation sends one bridge
+// command over I2C, and poll() reads the bridge's status once the command
+// should be done, until it is. In between, the MCU is free. The I2C
+// transfers themselves block, for about 0.3 ms each at 100 kHz (the Wire
+// library default) or 0.1 ms at 400 kHz.
+//
+// The polled operations, poll_status flags and results are the same as
+// PolledOneWire's, as far as the bridge has them. Sketches using this must
+// include Wire.h and call Wire.begin() before begin().
+//
+// Only standard speed is supported.
+//
+// This is a master of its own, not a backend for PolledOneWire: the queue,
+// polled_read_batch(), PolledDS18x20, PolledDS2408, PolledOneWireMemory and
+// PolledOneWireRegistry all take a PolledOneWire, and don't run over the
+// bridge. Sequence its operations from the sketch instead.
+
+class PolledDS2482
+{
+  public:
+	PolledDS2482( uint8_t address = 0x18 ); // 0x18 - 0x1F, from the AD pins
+
+	bool begin(); // Resets the bridge. False if it doesn't answer.
+	bool select_channel( uint8_t channel ); // DS2482-800 only, 0 - 7
+	void depower(); // End the strong pullup of a polled_write() with power
+
+	void polled_reset(); // Result in reset_result
+	void polled_write( uint8_t v, uint8_t power = 0 );
+	void polled_read(); // Result in readWriteByte
+	void polled_bit( uint8_t v ); // Write a bit; a 1 reads one, result in readWriteByte
+	void polled_triplet( uint8_t direction ); // Result in triplet_result
+	void polled_skip();
+	void polled_select( const uint8_t rom[8] ); // No copy, rom must stay valid
+	void polled_write_from( const uint8_t *buf, uint16_t count, bool power = 0 ); // No copy, buf must stay valid
+	void polled_read_into( uint8_t *buf, uint16_t count );
+#if ONEWIRE_SEARCH
+	void reset_search();
+	void target_search( uint8_t family_code );
+	void family_skip_search();
+	void polled_search( bool search_mode = true ); // Result in search_result, ROM in readWriteBuffer[0..7]
+#endif
+
+	void poll(); // Call this as long as poll_status != 0
+
+	uint16_t poll_status; // Same ONEWIRE_POLLSTAT_* values as PolledOneWire
+	bool reset_result;
+	bool short_detected; // Short on the 1-Wire line at the last reset
+	bool bridge_ok; // False once an I2C transfer to the bridge has failed
+	uint8_t readWriteByte;
+	uint8_t triplet_result; // ONEWIRE_TRIPLET_* bits
+#if ONEWIRE_SEARCH
+	uint8_t search_result;
+#endif
+	uint8_t readWriteBuffer[8];
+
+  private:
+	uint8_t address;
+	uint8_t config;
+	uint8_t command; // 1-Wire command in progress
+	unsigned long bitNextTime; // When to look at the status for the end of it
+	bool powerAfter;
+	const uint8_t *writePtr;
+	uint8_t *readPtr;
+	uint16_t byteCount;
+	uint16_t byteIndex;
+	bool writeBytesPower;
+
+	bool bridge_write( uint8_t b0, uint8_t b1, uint8_t len );
+	bool bridge_read( uint8_t *b );
+	void one_wire( uint8_t cmd, uint8_t arg, uint8_t len, unsigned int us );
+	void write_next_byte();
+
+#if ONEWIRE_SEARCH
+	PolledOneWireSearch searchState;
+	uint8_t search_phase; // Same ONEWIRE_SEARCHSTAT_* values as PolledOneWire
+	void search_end();
+#endif
+};
+
+#endif
@@ -19,7 +19,16 @@ requires precise timing, generally accomplished by a call to delayMicros() with
 interrupts disabled.
 
 The rule of thumb is that delays of any call to a function or, subsequently, to
-poll() must not include substantial delay. So far, the largest delay is 80 us.
+poll() must not include substantial delay. The longest windows with interrupts
+disabled are:
+  - standard speed: 80 us for the presence sample after a reset, plus one micros()
+    call that checks how long the reset low was; 65 us for a write-0 slot, 13 us
+    for a read slot
+  - overdrive speed: 78 us for a whole reset (70 us low, then the presence sample);
+    8 us for a slot
+  - PolledOneWireMulti: 80 us for the presence sample after a reset
+With ONEWIRE_TIMER_POLL, the timer interrupt's own work adds to these.
+extras/sim_tests/test_slots.cpp checks them against OneWireSim::max_critical.
 It is possible that excessive time between polls could cause problems. If at all
 possible, only interleave simple operations (e.g. checking a timer and setting a
 pin) between polls. Things like serial operations are best done outside of polling.
@@ -31,11 +40,21 @@ is possible, in the interest of performance and space such checks are deleted.
 write_bit() is unchanged. It includes 65 or 70 us of delay.
 read_bit() is unchanged. It includes 66 us of delay.
 
-NOTE: These two functions could be optimized in the future. read_bit() only has 13 us of 
-critical delay; 50 us could be replaced with polling. write_bit()'s timing depends on the 
-bit value. Writing a 1 only requires 10 us critical delay and 55 us time that could
-be replaced with polling. Writing a 0 can't be optimized; 65 us delay is
-criticual, and the remaining 5 us delay isn't worth optimizing.
+Overdrive: after overdrive_skip() or overdrive_select() (or their polled_ and queue_
+counterparts) the member variable overdrive is true and all functions use overdrive
+timings: a 70 us reset pulse with presence sampled 8 us after it, and bit slots of about
+10 us. Since a whole overdrive slot is shorter than the critical part of a standard one,
+polled functions do each overdrive bit in a single poll, with no more than 9 us of delay.
+The overdrive reset can't be stretched either, so the poll that starts it has 78 us of
+delay and the remaining 40 us is polled.
+
+The polled functions don't use write_bit() and read_bit(). They split each bit slot
+in two: only the start of the slot is timing critical and is done with interrupts
+disabled, and the rest of the slot is recovery time that poll() waits out against a
+micros() deadline, the way polled_reset() does. read_bit() only has 13 us of critical
+delay; the remaining 53 us is polled. Writing a 1 only requires 10 us critical delay,
+and the remaining 55 us is polled. Writing a 0 can't be optimized; 65 us delay is
+critical, and only the remaining 5 us is polled.
 
 The following functions are optimized:
 
@@ -44,31 +63,121 @@ Subsequent poll() - A single poll will have 80 us delay. All other polls will ha
 explicit delay. Total polling time: 1000 - 1250 us. The member variable reset_result
 will be true if any devices are present on the bus, false otherwise.
 
-polled_write() - 65-70 us delay.
-Subsequent poll() - 7 polls each with 65-70 us delay.
-
-polled_read() - 66 us delay.
-Subsequent poll() - 7 polls each with 66 us delay. When it completes, the resulting byte
-will be stored in the member variable readWriteByte
+Overruns: the low part of a standard speed reset is the one timed phase that spans two
+polls, so a late poll makes it longer. Its deadline is taken from the moment the line
+went low, with interrupts still disabled, and the poll that ends it checks how long it
+really was. Past ONEWIRE_RESET_LOW_MAX_US, the devices may have taken it for a power-on
+reset, so once it has recovered the reset is done again by itself, up to
+ONEWIRE_OVERRUN_RETRIES times; overruns counts these. If the last try still overran,
+overrun is set, a queued transaction stops with ONEWIRE_QUEUE_OVERRUN, and
+polled_read_batch() reads that device again (see batch_retries) or gives it
+ONEWIRE_BATCH_OVERRUN. All other timed parts are done with interrupts disabled, and the
+recovery times that follow them are minimums, so a late poll only makes them longer.
+Deadlines are kept from the edge each phase is timed from rather than from an ideal
+timeline: catching up on lateness would cut the next phase below its minimum.
+
+polled_write() - 10 us delay if the first bit is a 1, 65 us if it is a 0.
+Subsequent poll() - Polls that find the previous slot still recovering have no
+explicit delay. Once it has recovered, the poll starts the next bit, with 10 or 65 us
+delay as above. Each bit takes about 70 us in total.
+
+polled_read() - 13 us delay.
+Subsequent poll() - As for polled_write(), but each bit started has 13 us delay. When
+it completes, the resulting byte will be stored in the member variable readWriteByte
 
 Note: All multi-byte operations must read or write <= ONEWIRE_MAX_READ_WRITE_BUFFER_LEN
 which may be redefined in user code. This should never be less than 9 as that is the number
 of bytes needed for a Select.
 
-polled_write_bytes() - Makes N calls to polled_write(). There will be 8N-1 calls to poll()
-needed for the operation to complete, each with 65-70 us delay.
+polled_write_bytes() - Makes N calls to polled_write(). Each poll that starts a bit has
+10 or 65 us delay as above.
 
-polled_read_bytes() - Makes N calls to polled_read(). There will be 8N calls to poll() needed
-for the operation to complete, and all but the last will have 66 us delay; the last will have no
-delay. When it completes, the resulting bytes will be stored in the member variable 
+polled_read_bytes() - Makes N calls to polled_read(). Each poll that starts a bit has
+13 us delay. When it completes, the resulting bytes will be stored in the member variable
 readWriteBuffer.
 
-polled_select() - A shortcut that does a polled write of 9 bytes.
+polled_write_from() / polled_read_into() - As polled_write_bytes() and
+polled_read_bytes(), but straight from or into a buffer of the caller's, up to 65535
+bytes, so e.g. a whole memory page can be read in one polled operation. The buffer must
+stay valid until poll_status clears. If these are all you use for longer transfers,
+ONEWIRE_MAX_READ_WRITE_BUFFER_LEN can be cut down to the 9 bytes polled_select() needs.
+
+CRC checks: polled_read_bytes() and polled_read_into() can check a CRC8 (ONEWIRE_CRC_8,
+e.g. a scratchpad) or CRC16 (ONEWIRE_CRC_16, e.g. a DS2408 register read) at the end of
+the bytes read. Each byte is added to a running CRC by the poll that finishes it, so when
+poll_status clears, crc_ok is already set and there is no second pass over the buffer.
+For a CRC16 that also covers command bytes, pass their crc16() as crc_seed.
+
+polled_select() - A shortcut that does a polled write of 9 bytes, or of 1 byte with Resume.
+
+Resume: with ONEWIRE_RESUME (the default), select(), polled_select() and queue_select()
+remember the ROM they selected. Selecting the same device again, with nothing but
+resets in between, sends Resume (0xA5) instead of Match ROM and the ROM, 8 slots
+rather than 72, if the device's family is one that supports it (DS2408, DS2431,
+DS2413, DS28EA00, DS28EC20). Any other ROM command written after a reset, e.g. Skip ROM,
+a search or a Match ROM written by hand, or a reset with no presence, makes it forget.
+queue_select() decides when the step runs, so a queue that is started again uses Resume
+from then on.
 
 polled_skip() - A shortcut that does a polled write of 1 byte.
 
-At present, search functions are not optimized. It is anticipated that searching for
-OneWire devices will happen on startup before timing-critical things need to happen.
+queue_start() - Runs the steps queued with queue_reset(), queue_skip(), queue_select(),
+queue_write_byte(), queue_write(), queue_read(), queue_power() and queue_delay(). Each
+poll does the work of the step it is in, with the delays described above for that kind of
+operation, and moves on to the next step by itself as soon as one finishes, so e.g. a
+whole reset, select, Read Scratchpad and 9 byte read needs a single spin on poll().
+queue_power() and queue_delay() add no delay to any poll. Reads go straight into the
+buffers passed to queue_read(). If a queued reset finds no device, the rest of the queue
+is skipped and queue_result is ONEWIRE_QUEUE_NO_PRESENCE, otherwise ONEWIRE_QUEUE_OK.
+
+polled_read_batch() - Reads the scratchpad (or whatever the command given reads, with a
+CRC8 as its last byte) of each device in a list of ROMs: for each, a queued reset, Match
+ROM and command, then a polled_read_into() with CRC8 check, so every poll has the delay
+of those. The results for device i go to buf[i * len], and result[i] is
+ONEWIRE_BATCH_OK, ONEWIRE_BATCH_NO_PRESENCE or ONEWIRE_BATCH_CRC_ERROR. It uses the
+transaction queue, so don't queue anything else until poll_status clears. With
+ONEWIRE_CRC_NONE, len can be less than the whole scratchpad, e.g. just the 2 temperature
+bytes of a DS18B20, which saves 56 slots per device: the reset that addresses the next
+device ends each read, and one more reset ends the last one. There is then no check
+beyond presence. A device with a CRC error or overrun is read again, up to batch_retries
+times (1 by default), before it gets that result.
+The queue is kept after it runs, so the same transaction can be started again.
+
+start_timer_poll() - Only with ONEWIRE_TIMER_POLL. Rather than calling poll() until
+poll_status == 0, call this once after starting any of the polled operations. A timer
+compare interrupt then calls poll() each time the operation has something to do,
+scheduled from the same micros() deadlines poll() uses, so the main loop only needs to
+check poll_status. The delays listed above then happen inside the interrupt; other
+interrupts may still nest outside the timing critical parts, as they can when poll() is
+called from the main loop.
+
+Instrumentation: with ONEWIRE_STATS defined to 1, the member variable stats counts
+calls to poll(), the total and longest time spent inside poll(), the total and longest
+time spent with interrupts disabled, the longest gap between two polls while an
+operation was in progress, and how many deadlines a poll found more than
+ONEWIRE_STATS_LATE_US late. last_op_polls is the number of polls the last operation took
+to complete. Times are measured with micros(), so they are only as fine as its resolution
+(4 us on a 16 MHz AVR) and include its overhead. stats_clear() zeroes them.
+
+polled_wait_ready() - Issues a read slot (13 us delay) and, while the device answers
+it with a 0, another one every interval_us, until it answers with a 1 or timeout_us has
+passed. Polls in between have no explicit delay. ready_result tells which it was. This
+lets a device that answers read slots while busy, such as an externally powered DS18B20
+converting, say when it has finished, rather than waiting out the datasheet maximum.
+Not for EEPROM copies: a slot during tPROG spoils the copy, so wait that out with the
+bus idle.
+
+polled_triplet() - One step of a search: reads a bit and its complement, and writes
+back the bit all devices had, or the direction given if they differed (a 1 if nobody
+answered). Each poll does one of the three slots, so no poll has more than the delay
+of a single bit. triplet_result has the bits read and the bit written. This is the
+same operation as the DS2482 1-Wire Triplet command.
+
+polled_search() - The polled counterpart of search(). It does a polled_reset() and a
+polled_write() of the search command, then a polled_triplet() for each of the 64 bits. When it completes, search_result is true if a new device was
+found, and its ROM is stored in the first 8 bytes of readWriteBuffer. search(),
+reset_search(), target_search() and family_skip_search() share their state with it, and
+polled_search(false) is the Conditional Search, as with search(addr, false).
   
 Copyright (c) 2007, Jim Studt  (original old version - many contributors since)
 
@@ -170,12 +279,30 @@ sample code bearing this copyright.
 #include "PolledOneWire.h"
 
 
+#if ONEWIRE_PIN_TEMPLATE
+PolledOneWire::PolledOneWire(uint8_t pin, PolledOneWirePinTemplate)
+#else
 PolledOneWire::PolledOneWire(uint8_t pin)
+#endif
 {
 	pinMode(pin, INPUT);
 	bitmask = PIN_TO_BITMASK(pin);
 	baseReg = PIN_TO_BASEREG(pin);
 	poll_status = ONEWIRE_POLLSTAT_NONE;
+	bit_status = ONEWIRE_BITSTAT_NONE;
+	overdrive = false;
+	overdrivePending = false;
+	overrun = false;
+	overruns = 0;
+	batch_retries = 1;
+	queueLen = 0;
+#if ONEWIRE_RESUME
+	resumeValid = false;
+	romCommandNext = false;
+#endif
+#if ONEWIRE_STATS
+	stats_clear();
+#endif
 #if ONEWIRE_SEARCH
 	reset_search();
 #endif
@@ -204,17 +331,21 @@ uint8_t PolledOneWire::reset(void)
 		delayMicroseconds(2);
 	} while ( !DIRECT_READ(reg, mask));
 
-	noInterrupts();
-	DIRECT_WRITE_LOW(reg, mask);
-	DIRECT_MODE_OUTPUT(reg, mask);	// drive output low
-	interrupts();
-	delayMicroseconds(500);
-	noInterrupts();
-	DIRECT_MODE_INPUT(reg, mask);	// allow it to float
-	delayMicroseconds(80);
-	r = !DIRECT_READ(reg, mask);
-	interrupts();
-	delayMicroseconds(420);
+	if (!overdrive) {
+		noInterrupts();
+		DIRECT_WRITE_LOW(reg, mask);
+		DIRECT_MODE_OUTPUT(reg, mask);	// drive output low
+		resetLowStart = micros();
+		interrupts();
+		delayMicroseconds(500);
+	}
+	r = critical_reset_presence();
+	delayMicroseconds(overdrive ? 40 : 420);
+#if ONEWIRE_RESUME
+	romCommandNext = true;
+	if ( !r )
+		resumeValid = false; // Whatever was selected may have gone
+#endif
 	return r;
 }
 
@@ -224,26 +355,8 @@ uint8_t PolledOneWire::reset(void)
 //
 void PolledOneWire::write_bit(uint8_t v)
 {
-	IO_REG_TYPE mask=bitmask;
-	volatile IO_REG_TYPE *reg IO_REG_ASM = baseReg;
-
-	if (v & 1) {
-		noInterrupts();
-		DIRECT_WRITE_LOW(reg, mask);
-		DIRECT_MODE_OUTPUT(reg, mask);	// drive output low
-		delayMicroseconds(10);
-		DIRECT_WRITE_HIGH(reg, mask);	// drive output high
-		interrupts();
-		delayMicroseconds(55);
-	} else {
-		noInterrupts();
-		DIRECT_WRITE_LOW(reg, mask);
-		DIRECT_MODE_OUTPUT(reg, mask);	// drive output low
-		delayMicroseconds(65);
-		DIRECT_WRITE_HIGH(reg, mask);	// drive output high
-		interrupts();
-		delayMicroseconds(5);
-	}
+	critical_write_slot(v);
+	delayMicroseconds(write_recovery(v));
 }
 
 //
@@ -252,20 +365,101 @@ void PolledOneWire::write_bit(uint8_t v)
 //
 uint8_t PolledOneWire::read_bit(void)
 {
-	IO_REG_TYPE mask=bitmask;
-	volatile IO_REG_TYPE *reg IO_REG_ASM = baseReg;
 	uint8_t r;
 
-	noInterrupts();
-	DIRECT_MODE_OUTPUT(reg, mask);
-	DIRECT_WRITE_LOW(reg, mask);
-	delayMicroseconds(3);
-	DIRECT_MODE_INPUT(reg, mask);	// let pin float, pull up will raise
-	delayMicroseconds(10);
-	r = DIRECT_READ(reg, mask);
-	interrupts();
-	delayMicroseconds(53);
+	r = critical_read_slot();
+	delayMicroseconds(read_recovery());
+	return r;
+}
+
+//
+// Recovery time left in a slot once its critical part is done. The whole
+// slot is about 70 us, or 10 us at overdrive speed.
+//
+uint8_t PolledOneWire::write_recovery(uint8_t v)
+{
+	if (overdrive)
+		return (v & 1) ? 8 : 3;
+	return (v & 1) ? 55 : 5;
+}
+
+uint8_t PolledOneWire::read_recovery()
+{
+	return overdrive ? 7 : 53;
+}
+
+//
+// Default slot primitives, using the pin from the constructor.
+//
+void PolledOneWire::write_slot(uint8_t v)
+{
+	volatile IO_REG_TYPE *reg IO_REG_ASM = baseReg;
+
+	onewire_write_slot(reg, bitmask, v, overdrive);
+}
+
+uint8_t PolledOneWire::read_slot()
+{
+	volatile IO_REG_TYPE *reg IO_REG_ASM = baseReg;
+
+	return onewire_read_slot(reg, bitmask, overdrive);
+}
+
+uint8_t PolledOneWire::reset_presence()
+{
+	volatile IO_REG_TYPE *reg IO_REG_ASM = baseReg;
+
+	return onewire_reset_presence(reg, bitmask, overdrive, resetLowStart, &resetOverrun);
+}
+
+//
+// Run the slot primitives, counting the time spent with interrupts disabled
+// when ONEWIRE_STATS is on. The count includes the cost of two micros() calls.
+//
+#if ONEWIRE_STATS
+void PolledOneWire::stats_critical(unsigned long start)
+{
+	unsigned long us = micros() - start;
+
+	stats.critical_us += us;
+	if (us > stats.max_critical_us)
+		stats.max_critical_us = us;
+}
+#endif
+
+void PolledOneWire::critical_write_slot(uint8_t v)
+{
+#if ONEWIRE_STATS
+	unsigned long start = micros();
+	write_slot(v);
+	stats_critical(start);
+#else
+	write_slot(v);
+#endif
+}
+
+uint8_t PolledOneWire::critical_read_slot()
+{
+#if ONEWIRE_STATS
+	unsigned long start = micros();
+	uint8_t r = read_slot();
+	stats_critical(start);
+	return r;
+#else
+	return read_slot();
+#endif
+}
+
+uint8_t PolledOneWire::critical_reset_presence()
+{
+#if ONEWIRE_STATS
+	unsigned long start = micros();
+	uint8_t r = reset_presence();
+	stats_critical(start);
 	return r;
+#else
+	return reset_presence();
+#endif
 }
 
 //
@@ -278,6 +472,11 @@ uint8_t PolledOneWire::read_bit(void)
 void PolledOneWire::write(uint8_t v, uint8_t power /* = 0 */) {
     uint8_t bitMask;
 
+#if ONEWIRE_RESUME
+    if ( romCommandNext )
+	rom_command(v);
+#endif
+
     for (bitMask = 0x01; bitMask; bitMask <<= 1) {
 	PolledOneWire::write_bit( (bitMask & v)?1:0);
     }
@@ -325,11 +524,71 @@ void PolledOneWire::select( uint8_t rom[8])
 {
     int i;
 
+    if ( select_command(rom) == 0xA5 ) {
+	write(0xA5);           // Resume
+	return;
+    }
     write(0x55);           // Choose ROM
 
     for( i = 0; i < 8; i++) write(rom[i]);
 }
 
+//
+// The ROM command a select of rom starts with: Resume if rom was selected
+// last and supports it, Match ROM otherwise. Either way, rom is then the
+// device selected last.
+//
+uint8_t PolledOneWire::select_command(const uint8_t rom[8])
+{
+#if ONEWIRE_RESUME
+    romCommandNext = false;
+    if ( resumeValid && memcmp(rom, resumeRom, 8) == 0 )
+	return 0xA5;
+    // A Match ROM clears the RC flag of every device it doesn't select
+    memcpy(resumeRom, rom, 8);
+    resumeValid = resume_supported(rom[0]);
+#else
+    (void) rom;
+#endif
+    return 0x55;
+}
+
+#if ONEWIRE_RESUME
+// Families that answer Resume (0xA5)
+static const uint8_t PROGMEM resume_families[] = {
+    0x29,	// DS2408
+    0x2D,	// DS2431
+    0x3A,	// DS2413
+    0x42,	// DS28EA00
+    0x43,	// DS28EC20
+};
+
+bool PolledOneWire::resume_supported(uint8_t family_code)
+{
+    for ( uint8_t i = 0; i < sizeof(resume_families); i++ )
+	if ( pgm_read_byte(resume_families + i) == family_code )
+	    return true;
+    return false;
+}
+
+void PolledOneWire::resume_clear()
+{
+    resumeValid = false;
+}
+
+//
+// A ROM command is going out after a reset. Anything but Resume, short of
+// select_command() having checked it, may leave some other device with the
+// RC flag.
+//
+void PolledOneWire::rom_command(uint8_t v)
+{
+    romCommandNext = false;
+    if ( v != 0xA5 )
+	resumeValid = false;
+}
+#endif
+
 //
 // Do a ROM skip
 //
@@ -338,6 +597,30 @@ void PolledOneWire::skip()
     write(0xCC);           // Skip ROM
 }
 
+//
+// Do an Overdrive Skip ROM. The command goes out at standard speed, and
+// everything after it, including the next reset, is at overdrive speed.
+//
+void PolledOneWire::overdrive_skip()
+{
+    write(0x3C);           // Overdrive Skip ROM
+    overdrive = true;
+}
+
+//
+// Do an Overdrive Match ROM. Only the command byte is sent at standard
+// speed, the ROM already goes at overdrive speed.
+//
+void PolledOneWire::overdrive_select( uint8_t rom[8])
+{
+    int i;
+
+    write(0x69);           // Overdrive Match ROM
+    overdrive = true;
+
+    for( i = 0; i < 8; i++) write(rom[i]);
+}
+
 void PolledOneWire::depower()
 {
 	noInterrupts();
@@ -348,10 +631,9 @@ void PolledOneWire::depower()
 #if ONEWIRE_SEARCH
 
 //
-// You need to use this function to start a search again from the beginning.
-// You do not need to do it for the first search, though you could.
+// Clear the search state, so the next pass is like a first.
 //
-void PolledOneWire::reset_search()
+void PolledOneWireSearch::reset()
   {
   // reset the search state
   LastDiscrepancy = 0;
@@ -364,6 +646,183 @@ void PolledOneWire::reset_search()
     }
   }
 
+//
+// Set up the search state to find devices of the given family first.
+// From Maxim Application Note 187 (OWTargetSetup): setting
+// LastDiscrepancy past the end makes the next search follow the family
+// code in ROM_NO and take the 0 branch everywhere after it, so it finds
+// the lowest ROM with that family code, or the first device after it if
+// there is none.
+//
+void PolledOneWireSearch::target(uint8_t family_code)
+{
+   ROM_NO[0] = family_code;
+   for (uint8_t i = 1; i < 8; i++)
+      ROM_NO[i] = 0;
+   LastDiscrepancy = 64;
+   LastFamilyDiscrepancy = 0;
+   LastDeviceFlag = FALSE;
+}
+
+//
+// Set up the search state to skip the family of the device last found.
+// From Maxim Application Note 187 (OWFamilySkipSetup): going back to the
+// last discrepancy within the family code leaves the rest of that family
+// behind.
+//
+void PolledOneWireSearch::family_skip()
+{
+   LastDiscrepancy = LastFamilyDiscrepancy;
+   LastFamilyDiscrepancy = 0;
+
+   // check for end of list
+   if (LastDiscrepancy == 0)
+      LastDeviceFlag = TRUE;
+}
+
+void PolledOneWireSearch::begin(bool search_mode)
+{
+   command = search_mode ? 0xF0 : 0xEC;
+   bitNumber = 1;
+   lastZero = 0;
+   romByteNumber = 0;
+   romByteMask = 1;
+}
+
+uint8_t PolledOneWireSearch::direction()
+{
+   // if this discrepancy if before the Last Discrepancy
+   // on a previous next then pick the same as last time
+   if (bitNumber < LastDiscrepancy)
+      return ((ROM_NO[romByteNumber] & romByteMask) > 0);
+   // if equal to last pick 1, if not then pick 0
+   return (bitNumber == LastDiscrepancy);
+}
+
+//
+// Take one bit and its complement read from the bus, and decide which
+// way the search goes. Returns the bit to write back, or 2 if no
+// device answered. A bridge that writes the bit itself (a triplet)
+// takes the same way, given direction() beforehand.
+//
+uint8_t PolledOneWireSearch::next_bit(uint8_t id_bit, uint8_t cmp_id_bit)
+{
+   unsigned char search_direction;
+
+   // check for no devices on 1-wire
+   if ((id_bit == 1) && (cmp_id_bit == 1))
+      return 2;
+
+   // all devices coupled have 0 or 1
+   if (id_bit != cmp_id_bit)
+      search_direction = id_bit;  // bit write value for search
+   else
+   {
+      search_direction = direction();
+
+      // if 0 was picked then record its position in LastZero
+      if (search_direction == 0)
+      {
+         lastZero = bitNumber;
+
+         // check for Last discrepancy in family
+         if (lastZero < 9)
+            LastFamilyDiscrepancy = lastZero;
+      }
+   }
+
+   // set or clear the bit in the ROM byte rom_byte_number
+   // with mask rom_byte_mask
+   if (search_direction == 1)
+     ROM_NO[romByteNumber] |= romByteMask;
+   else
+     ROM_NO[romByteNumber] &= ~romByteMask;
+
+   // increment the byte counter id_bit_number
+   // and shift the mask rom_byte_mask
+   bitNumber++;
+   romByteMask <<= 1;
+
+   // if the mask is 0 then go to new SerialNum byte rom_byte_number and reset mask
+   if (romByteMask == 0)
+   {
+       romByteNumber++;
+       romByteMask = 1;
+   }
+   return search_direction;
+}
+
+//
+// Wrap up a search pass, which may have ended early: on no presence, on
+// no device answering a bit, or without touching the bus at all after
+// the last device.
+//
+uint8_t PolledOneWireSearch::end()
+{
+   uint8_t search_result = FALSE;
+
+   // if the search was successful then
+   if (done())
+   {
+      // search successful so set LastDiscrepancy,LastDeviceFlag,search_result
+      LastDiscrepancy = lastZero;
+
+      // check for last device
+      if (LastDiscrepancy == 0)
+         LastDeviceFlag = TRUE;
+
+      search_result = TRUE;
+   }
+
+   // if no device found then reset counters so next 'search' will be like a first
+   if (!search_result || !ROM_NO[0])
+   {
+      LastDiscrepancy = 0;
+      LastDeviceFlag = FALSE;
+      LastFamilyDiscrepancy = 0;
+      search_result = FALSE;
+   }
+   return search_result;
+}
+
+//
+// You need to use this function to start a search again from the beginning.
+// You do not need to do it for the first search, though you could.
+//
+void PolledOneWire::reset_search()
+{
+   searchState.reset();
+}
+
+void PolledOneWire::target_search(uint8_t family_code)
+{
+   searchState.target(family_code);
+}
+
+void PolledOneWire::family_skip_search()
+{
+   searchState.family_skip();
+}
+
+//
+// Verify that a device is on the bus. From Maxim Application Note 187
+// (OWVerify): a search pass set up as for target_search(), but with the
+// whole ROM, ends on that ROM only if the device answered all the way.
+//
+bool PolledOneWire::verify(const uint8_t rom[8])
+{
+   PolledOneWireSearch backup = searchState;
+   uint8_t found[8];
+   bool result;
+
+   searchState.target(rom[0]);
+   memcpy(searchState.ROM_NO, rom, 8);
+   result = search(found) && memcmp(found, rom, 8) == 0;
+
+   searchState = backup;
+   return result;
+}
+
 //
 // Perform a search. If this function returns a '1' then it has
 // enumerated the next device and you may retrieve the ROM from the
@@ -380,36 +839,30 @@ void PolledOneWire::reset_search()
 // Return TRUE  : device found, ROM number in ROM_NO buffer
 //        FALSE : device not found, end of search
 //
-uint8_t PolledOneWire::search(uint8_t *newAddr)
+// search_mode true is the normal Search ROM (0xF0), false the Conditional
+// Search (0xEC), which only devices with an alarm condition answer.
+//
+uint8_t PolledOneWire::search(uint8_t *newAddr, bool search_mode /* = true */)
 {
-   uint8_t id_bit_number;
-   uint8_t last_zero, rom_byte_number, search_result;
    uint8_t id_bit, cmp_id_bit;
-
-   unsigned char rom_byte_mask, search_direction;
+   unsigned char search_direction;
+   uint8_t search_result;
 
    // initialize for search
-   id_bit_number = 1;
-   last_zero = 0;
-   rom_byte_number = 0;
-   rom_byte_mask = 1;
-   search_result = 0;
+   searchState.begin(search_mode);
 
    // if the last call was not the last one
-   if (!LastDeviceFlag)
+   if (!searchState.LastDeviceFlag)
    {
       // 1-Wire reset
       if (!reset())
       {
          // reset the search
-         LastDiscrepancy = 0;
-         LastDeviceFlag = FALSE;
-         LastFamilyDiscrepancy = 0;
-         return FALSE;
+         return searchState.end();
       }
 
       // issue the search command
-      write(0xF0);
+      write(searchState.command);
 
       // loop to do the search
       do
@@ -419,84 +872,20 @@ uint8_t PolledOneWire::search(uint8_t *newAddr)
          cmp_id_bit = read_bit();
 
          // check for no devices on 1-wire
-         if ((id_bit == 1) && (cmp_id_bit == 1))
+         search_direction = searchState.next_bit(id_bit, cmp_id_bit);
+         if (search_direction > 1)
             break;
-         else
-         {
-            // all devices coupled have 0 or 1
-            if (id_bit != cmp_id_bit)
-               search_direction = id_bit;  // bit write value for search
-            else
-            {
-               // if this discrepancy if before the Last Discrepancy
-               // on a previous next then pick the same as last time
-               if (id_bit_number < LastDiscrepancy)
-                  search_direction = ((ROM_NO[rom_byte_number] & rom_byte_mask) > 0);
-               else
-                  // if equal to last pick 1, if not then pick 0
-                  search_direction = (id_bit_number == LastDiscrepancy);
-
-               // if 0 was picked then record its position in LastZero
-               if (search_direction == 0)
-               {
-                  last_zero = id_bit_number;
-
-                  // check for Last discrepancy in family
-                  if (last_zero < 9)
-                     LastFamilyDiscrepancy = last_zero;
-               }
-            }
-
-            // set or clear the bit in the ROM byte rom_byte_number
-            // with mask rom_byte_mask
-            if (search_direction == 1)
-              ROM_NO[rom_byte_number] |= rom_byte_mask;
-            else
-              ROM_NO[rom_byte_number] &= ~rom_byte_mask;
-
-            // serial number search direction write bit
-            write_bit(search_direction);
-
-            // increment the byte counter id_bit_number
-            // and shift the mask rom_byte_mask
-            id_bit_number++;
-            rom_byte_mask <<= 1;
-
-            // if the mask is 0 then go to new SerialNum byte rom_byte_number and reset mask
-            if (rom_byte_mask == 0)
-            {
-                rom_byte_number++;
-                rom_byte_mask = 1;
-            }
-         }
-      }
-      while(rom_byte_number < 8);  // loop until through all ROM bytes 0-7
-
-      // if the search was successful then
-      if (!(id_bit_number < 65))
-      {
-         // search successful so set LastDiscrepancy,LastDeviceFlag,search_result
-         LastDiscrepancy = last_zero;
-
-         // check for last device
-         if (LastDiscrepancy == 0)
-            LastDeviceFlag = TRUE;
 
-         search_result = TRUE;
+         // serial number search direction write bit
+         write_bit(search_direction);
       }
+      while(!searchState.done());  // loop until through all ROM bits
    }
 
-   // if no device found then reset counters so next 'search' will be like a first
-   if (!search_result || !ROM_NO[0])
-   {
-      LastDiscrepancy = 0;
-      LastDeviceFlag = FALSE;
-      LastFamilyDiscrepancy = 0;
-      search_result = FALSE;
-   }
-   for (int i = 0; i < 8; i++) newAddr[i] = ROM_NO[i];
+   search_result = searchState.end();
+   for (int i = 0; i < 8; i++) newAddr[i] = searchState.ROM_NO[i];
    return search_result;
-  }
+}
 
 #endif
 
@@ -533,36 +922,36 @@ static const uint8_t PROGMEM dscrc_table[] = {
 // compared to all those delayMicrosecond() calls.  But I got
 // confused, so I use this table from the examples.)
 //
-uint8_t PolledOneWire::crc8( uint8_t *addr, uint8_t len)
+uint8_t PolledOneWire::crc8_update( uint8_t crc, uint8_t inbyte)
 {
-	uint8_t crc = 0;
-
-	while (len--) {
-		crc = pgm_read_byte(dscrc_table + (crc ^ *addr++));
-	}
-	return crc;
+	return pgm_read_byte(dscrc_table + (crc ^ inbyte));
 }
 #else
 //
 // Compute a Dallas Semiconductor 8 bit CRC directly.
 // this is much slower, but much smaller, than the lookup table.
 //
+uint8_t PolledOneWire::crc8_update( uint8_t crc, uint8_t inbyte)
+{
+	for (uint8_t i = 8; i; i--) {
+		uint8_t mix = (crc ^ inbyte) & 0x01;
+		crc >>= 1;
+		if (mix) crc ^= 0x8C;
+		inbyte >>= 1;
+	}
+	return crc;
+}
+#endif
+
 uint8_t PolledOneWire::crc8( uint8_t *addr, uint8_t len)
 {
 	uint8_t crc = 0;
-	
+
 	while (len--) {
-		uint8_t inbyte = *addr++;
-		for (uint8_t i = 8; i; i--) {
-			uint8_t mix = (crc ^ inbyte) & 0x01;
-			crc >>= 1;
-			if (mix) crc ^= 0x8C;
-			inbyte >>= 1;
-		}
+		crc = crc8_update(crc, *addr++);
 	}
 	return crc;
 }
-#endif
 
 #if ONEWIRE_CRC16
 bool PolledOneWire::check_crc16(uint8_t* input, uint16_t len, uint8_t* inverted_crc)
@@ -572,29 +961,81 @@ bool PolledOneWire::check_crc16(uint8_t* input, uint16_t len, uint8_t* inverted_
 }
 
 uint16_t PolledOneWire::crc16(uint8_t* input, uint16_t len)
+{
+    uint16_t crc = 0;    // Starting seed is zero.
+
+    for (uint16_t i = 0 ; i < len ; i++)
+      crc = crc16_update(crc, input[i]);
+    return crc;
+}
+
+#if ONEWIRE_CRC16_TABLE
+// CRC16 of each byte value, polynomial 0x8005 reflected (0xA001)
+static const uint16_t PROGMEM crc16_table[] = {
+    0x0000, 0xC0C1, 0xC181, 0x0140, 0xC301, 0x03C0, 0x0280, 0xC241,
+    0xC601, 0x06C0, 0x0780, 0xC741, 0x0500, 0xC5C1, 0xC481, 0x0440,
+    0xCC01, 0x0CC0, 0x0D80, 0xCD41, 0x0F00, 0xCFC1, 0xCE81, 0x0E40,
+    0x0A00, 0xCAC1, 0xCB81, 0x0B40, 0xC901, 0x09C0, 0x0880, 0xC841,
+    0xD801, 0x18C0, 0x1980, 0xD941, 0x1B00, 0xDBC1, 0xDA81, 0x1A40,
+    0x1E00, 0xDEC1, 0xDF81, 0x1F40, 0xDD01, 0x1DC0, 0x1C80, 0xDC41,
+    0x1400, 0xD4C1, 0xD581, 0x1540, 0xD701, 0x17C0, 0x1680, 0xD641,
+    0xD201, 0x12C0, 0x1380, 0xD341, 0x1100, 0xD1C1, 0xD081, 0x1040,
+    0xF001, 0x30C0, 0x3180, 0xF141, 0x3300, 0xF3C1, 0xF281, 0x3240,
+    0x3600, 0xF6C1, 0xF781, 0x3740, 0xF501, 0x35C0, 0x3480, 0xF441,
+    0x3C00, 0xFCC1, 0xFD81, 0x3D40, 0xFF01, 0x3FC0, 0x3E80, 0xFE41,
+    0xFA01, 0x3AC0, 0x3B80, 0xFB41, 0x3900, 0xF9C1, 0xF881, 0x3840,
+    0x2800, 0xE8C1, 0xE981, 0x2940, 0xEB01, 0x2BC0, 0x2A80, 0xEA41,
+    0xEE01, 0x2EC0, 0x2F80, 0xEF41, 0x2D00, 0xEDC1, 0xEC81, 0x2C40,
+    0xE401, 0x24C0, 0x2580, 0xE541, 0x2700, 0xE7C1, 0xE681, 0x2640,
+    0x2200, 0xE2C1, 0xE381, 0x2340, 0xE101, 0x21C0, 0x2080, 0xE041,
+    0xA001, 0x60C0, 0x6180, 0xA141, 0x6300, 0xA3C1, 0xA281, 0x6240,
+    0x6600, 0xA6C1, 0xA781, 0x6740, 0xA501, 0x65C0, 0x6480, 0xA441,
+    0x6C00, 0xACC1, 0xAD81, 0x6D40, 0xAF01, 0x6FC0, 0x6E80, 0xAE41,
+    0xAA01, 0x6AC0, 0x6B80, 0xAB41, 0x6900, 0xA9C1, 0xA881, 0x6840,
+    0x7800, 0xB8C1, 0xB981, 0x7940, 0xBB01, 0x7BC0, 0x7A80, 0xBA41,
+    0xBE01, 0x7EC0, 0x7F80, 0xBF41, 0x7D00, 0xBDC1, 0xBC81, 0x7C40,
+    0xB401, 0x74C0, 0x7580, 0xB541, 0x7700, 0xB7C1, 0xB681, 0x7640,
+    0x7200, 0xB2C1, 0xB381, 0x7340, 0xB101, 0x71C0, 0x7080, 0xB041,
+    0x5000, 0x90C1, 0x9181, 0x5140, 0x9301, 0x53C0, 0x5280, 0x9241,
+    0x9601, 0x56C0, 0x5780, 0x9741, 0x5500, 0x95C1, 0x9481, 0x5440,
+    0x9C01, 0x5CC0, 0x5D80, 0x9D41, 0x5F00, 0x9FC1, 0x9E81, 0x5E40,
+    0x5A00, 0x9AC1, 0x9B81, 0x5B40, 0x9901, 0x59C0, 0x5880, 0x9841,
+    0x8801, 0x48C0, 0x4980, 0x8941, 0x4B00, 0x8BC1, 0x8A81, 0x4A40,
+    0x4E00, 0x8EC1, 0x8F81, 0x4F40, 0x8D01, 0x4DC0, 0x4C80, 0x8C41,
+    0x4400, 0x84C1, 0x8581, 0x4540, 0x8701, 0x47C0, 0x4680, 0x8641,
+    0x8201, 0x42C0, 0x4380, 0x8341, 0x4100, 0x81C1, 0x8081, 0x4040};
+
+//
+// Table lookup version, one flash read per byte.
+//
+uint16_t PolledOneWire::crc16_update(uint16_t crc, uint8_t inbyte)
+{
+    return (crc >> 8) ^ pgm_read_word(crc16_table + ((crc ^ inbyte) & 0xFF));
+}
+#else
+uint16_t PolledOneWire::crc16_update(uint16_t crc, uint8_t inbyte)
 {
     static const uint8_t oddparity[16] =
         { 0, 1, 1, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0, 1, 1, 0 };
-    uint16_t crc = 0;    // Starting seed is zero.
 
-    for (uint16_t i = 0 ; i < len ; i++) {
-      // Even though we're just copying a byte from the input,
-      // we'll be doing 16-bit computation with it.
-      uint16_t cdata = input[i];
-      cdata = (cdata ^ (crc & 0xff)) & 0xff;
-      crc >>= 8;
+    // Even though we're just copying a byte from the input,
+    // we'll be doing 16-bit computation with it.
+    uint16_t cdata = inbyte;
+    cdata = (cdata ^ (crc & 0xff)) & 0xff;
+    crc >>= 8;
 
-      if (oddparity[cdata & 0x0F] ^ oddparity[cdata >> 4])
-          crc ^= 0xC001;
+    if (oddparity[cdata & 0x0F] ^ oddparity[cdata >> 4])
+        crc ^= 0xC001;
 
-      cdata <<= 6;
-      crc ^= cdata;
-      cdata <<= 1;
-      crc ^= cdata;
-    }
+    cdata <<= 6;
+    crc ^= cdata;
+    cdata <<= 1;
+    crc ^= cdata;
     return crc;
 }
 #endif
+#endif
+#endif
 
 // Perform the onewire reset function.  We will wait up to 250uS for
 // the bus to come high, if it doesn't then it is broken or shorted
@@ -605,6 +1046,12 @@ uint16_t PolledOneWire::crc16(uint8_t* input, uint16_t len)
 void PolledOneWire::polled_reset()
 {
 	poll_status |= ONEWIRE_POLLSTAT_RESET;
+	overrun = false;
+	resetOverrun = false;
+	resetTries = 0;
+#if ONEWIRE_RESUME
+	romCommandNext = true;
+#endif
 	IO_REG_TYPE mask = bitmask;
 	volatile IO_REG_TYPE *reg IO_REG_ASM = baseReg;
 
@@ -615,13 +1062,7 @@ void PolledOneWire::polled_reset()
 	// Now check if the line is high. If not, wait up to 250 us.
 	if ( DIRECT_READ(reg, mask) ) {
 		// Success!
-		noInterrupts();
-		DIRECT_WRITE_LOW(reg, mask);
-		DIRECT_MODE_OUTPUT(reg, mask);	// drive output low
-		interrupts();
-		bitNextTime = micros();
-		bitNextTime += 500; // Line should stay low for 500 us
-		bit_status = ONEWIRE_BITSTAT_RESET_WAIT_LOW;
+		start_reset_pulse();
 		return;
 	} else {
 		bitNextTime = micros();
@@ -632,20 +1073,47 @@ void PolledOneWire::polled_reset()
 }
 
 //
-// Write a byte. The writing code uses the active drivers to raise the
-// pin high, if you need power after the write (e.g. DS18S20 in
-// parasite power mode) then set 'power' to 1, otherwise the pin will
-// go tri-state at the end of the write to avoid heating in a short or
-// other mishap.
+// Start the reset pulse once the line is high. At standard speed poll() times
+// the 500 us low; at overdrive speed the low time has a maximum, so the whole
+// pulse and the presence sample are done here with interrupts disabled.
 //
-// We're just going to write 1 bit at a time. Each poll call will write the next bit.
-void PolledOneWire::polled_write(uint8_t v, uint8_t power /* = 0 */) {
-	readWriteByte = v;
+void PolledOneWire::start_reset_pulse()
+{
+	if (overdrive) {
+		reset_result = critical_reset_presence();
+		bitNextTime = micros();
+		bitNextTime += 40; // Now wait 40 more us
+		bit_status = ONEWIRE_BITSTAT_RESET_WAIT_FINISH;
+		return;
+	}
+	noInterrupts();
+	DIRECT_WRITE_LOW(baseReg, bitmask);
+	DIRECT_MODE_OUTPUT(baseReg, bitmask);	// drive output low
+	resetLowStart = micros(); // Before any interrupt can make it late
+	interrupts();
+	bitNextTime = resetLowStart + 500; // Line should stay low for 500 us
+	bit_status = ONEWIRE_BITSTAT_RESET_WAIT_LOW;
+}
+
+//
+// Write a byte. The writing code uses the active drivers to raise the
+// pin high, if you need power after the write (e.g. DS18S20 in
+// parasite power mode) then set 'power' to 1, otherwise the pin will
+// go tri-state at the end of the write to avoid heating in a short or
+// other mishap.
+//
+// We're just going to write 1 bit at a time. Each poll call will write the next bit.
+void PolledOneWire::polled_write(uint8_t v, uint8_t power /* = 0 */) {
+#if ONEWIRE_RESUME
+	if ( romCommandNext )
+		rom_command(v);
+#endif
+	readWriteByte = v;
 	writePower = power;
 	poll_status |= ONEWIRE_POLLSTAT_WRITE;
 	
     readWriteBitMask = 0x01;
-	PolledOneWire::write_bit( (readWriteBitMask & readWriteByte)?1:0);
+	start_write_bit( (readWriteBitMask & readWriteByte)?1:0);
 	readWriteBitMask <<= 1;
 }
 
@@ -656,7 +1124,7 @@ void PolledOneWire::polled_read() {
     readWriteByte = 0;
 	poll_status |= ONEWIRE_POLLSTAT_READ;
 	readWriteBitMask = 0x01;
-	if ( PolledOneWire::read_bit() ) 
+	if ( start_read_bit() ) 
 		readWriteByte |= readWriteBitMask;
 	readWriteBitMask <<= 1;
 }
@@ -670,38 +1138,549 @@ void PolledOneWire::polled_skip()
 }
 
 void PolledOneWire::polled_write_bytes(const uint8_t *buf, uint8_t count, bool power /* = 0 */) {
-	byteCount = min(count, ONEWIRE_MAX_READ_WRITE_BUFFER_LEN); // We will truncate if this is exceeded.
-	memcpy(readWriteBuffer, buf, byteCount);	
+	count = min(count, ONEWIRE_MAX_READ_WRITE_BUFFER_LEN); // We will truncate if this is exceeded.
+	memcpy(readWriteBuffer, buf, count);	
+	polled_write_from(readWriteBuffer, count, power);
+}
+
+void PolledOneWire::polled_read_bytes(uint8_t count, uint8_t crc_type /* = ONEWIRE_CRC_NONE */) {
+	polled_read_into(readWriteBuffer, min(count, ONEWIRE_MAX_READ_WRITE_BUFFER_LEN), crc_type); // We will truncate if this is exceeded.
+}
+
+//
+// Write count bytes straight from buf, which must stay valid until
+// poll_status clears.
+//
+void PolledOneWire::polled_write_from(const uint8_t *buf, uint16_t count, bool power /* = 0 */) {
+	if ( !count )
+		return;
+	writePtr = buf;
+	byteCount = count;
 	byteIndex = 0;
 	writeBytesPower = power;
 	poll_status |= ONEWIRE_POLLSTAT_WRITE_BYTES;
-	polled_write(readWriteBuffer[byteIndex]);
-	byteIndex++;
+	write_next_byte();
 }
 
-void PolledOneWire::polled_read_bytes(uint8_t count) {
-	byteCount = min(count, ONEWIRE_MAX_READ_WRITE_BUFFER_LEN); // We will truncate if this is exceeded.
+//
+// Read count bytes straight into buf. With a crc_type, each byte is added to
+// a running CRC as it comes in, starting from crc_seed (e.g. the CRC16 of the
+// command bytes written before), and crc_ok is set at the end.
+//
+void PolledOneWire::polled_read_into(uint8_t *buf, uint16_t count, uint8_t crc_type /* = ONEWIRE_CRC_NONE */,
+	uint16_t crc_seed /* = 0 */) {
+	crc_ok = false;
+	crcType = crc_type;
+	crcRunning = crc_seed;
+	if ( !count )
+		return;
+	readPtr = buf;
+	byteCount = count;
 	byteIndex = 0;
 	poll_status |= ONEWIRE_POLLSTAT_READ_BYTES;
 	polled_read();
 }
 
+//
+// Start writing the next byte of a polled_write_from().
+//
+void PolledOneWire::write_next_byte()
+{
+	// Only power the bus after the last byte
+	polled_write(writePtr[byteIndex], writeBytesPower && byteIndex == byteCount - 1);
+	byteIndex++;
+	if ( byteIndex == byteCount )
+		poll_status &= ~ONEWIRE_POLLSTAT_WRITE_BYTES; // The last byte is on its way
+}
+
 //
 // Do a ROM select
 //
 void PolledOneWire::polled_select( uint8_t rom[8])
 {
     uint8_t tmp[9];
-	tmp[0] = 0x55; // Choose ROM
+	tmp[0] = select_command(rom); // Choose ROM, or Resume
+	if ( tmp[0] == 0xA5 ) {
+		polled_write(tmp[0]);
+		return;
+	}
 	memcpy( tmp+1, rom, 8 );
 	polled_write_bytes(tmp, 9);
 }
 
+//
+// Do an Overdrive Skip ROM. The bus switches to overdrive speed once the
+// command byte is out.
+//
+void PolledOneWire::polled_overdrive_skip()
+{
+	polled_write(0x3C);           // Overdrive Skip ROM
+	overdrivePending = true;
+}
+
+//
+// Do an Overdrive Match ROM. The ROM bytes go at overdrive speed.
+//
+void PolledOneWire::polled_overdrive_select( uint8_t rom[8])
+{
+    uint8_t tmp[9];
+	tmp[0] = 0x69; // Overdrive Match ROM
+	memcpy( tmp+1, rom, 8 );
+	polled_write_bytes(tmp, 9);
+	overdrivePending = true;
+}
+
+//
+// Start a write slot. Only the part of the slot that has to be timed exactly is
+// done here; poll() waits out the recovery time before the next slot.
+//
+void PolledOneWire::start_write_bit(uint8_t v)
+{
+	critical_write_slot(v);
+	if (overdrive) {
+		// A whole overdrive slot is shorter than the critical part of a
+		// standard speed one, and too short to time with micros().
+		delayMicroseconds(write_recovery(v));
+		bit_status = ONEWIRE_BITSTAT_NONE;
+		return;
+	}
+	bitNextTime = micros();
+	bitNextTime += write_recovery(v); // Remainder of the slot
+	bit_status = ONEWIRE_BITSTAT_SLOT_RECOVERY;
+}
+
+//
+// Start a read slot and sample the bit. poll() waits out the recovery time
+// before the next slot.
+//
+uint8_t PolledOneWire::start_read_bit()
+{
+	uint8_t r;
+
+	r = critical_read_slot();
+	if (overdrive) {
+		delayMicroseconds(read_recovery());
+		bit_status = ONEWIRE_BITSTAT_NONE;
+		return r;
+	}
+	bitNextTime = micros();
+	bitNextTime += read_recovery(); // Remainder of the slot
+	bit_status = ONEWIRE_BITSTAT_SLOT_RECOVERY;
+	return r;
+}
+
+//
+// Transaction queue
+//
+void PolledOneWire::queue_clear()
+{
+	queueLen = 0;
+}
+
+bool PolledOneWire::queue_add(uint8_t op, uint8_t count)
+{
+	if ( queueLen >= ONEWIRE_MAX_QUEUE_LEN )
+		return false;
+	queueSteps[queueLen].op = op;
+	queueSteps[queueLen].count = count;
+	queueLen++;
+	return true;
+}
+
+bool PolledOneWire::queue_reset()
+{
+	return queue_add(ONEWIRE_STEP_RESET, 0);
+}
+
+bool PolledOneWire::queue_write_byte(uint8_t v, uint8_t power /* = 0 */)
+{
+	if ( !queue_add(ONEWIRE_STEP_WRITE_BYTE, power) )
+		return false;
+	queueSteps[queueLen-1].value = v;
+	return true;
+}
+
+bool PolledOneWire::queue_write(const uint8_t *buf, uint8_t count, bool power /* = 0 */)
+{
+	if ( !queue_add(power ? ONEWIRE_STEP_WRITE_POWER : ONEWIRE_STEP_WRITE, count) )
+		return false;
+	queueSteps[queueLen-1].writeBuf = buf;
+	return true;
+}
+
+bool PolledOneWire::queue_read(uint8_t *buf, uint8_t count)
+{
+	if ( !queue_add(ONEWIRE_STEP_READ, count) )
+		return false;
+	queueSteps[queueLen-1].readBuf = buf;
+	return true;
+}
+
+bool PolledOneWire::queue_skip()
+{
+	return queue_write_byte(0xCC);           // Skip ROM
+}
+
+bool PolledOneWire::queue_select(const uint8_t rom[8])
+{
+	if ( !queue_add(ONEWIRE_STEP_SELECT, 9) )
+		return false;
+	queueSteps[queueLen-1].writeBuf = rom;
+	return true;
+}
+
+bool PolledOneWire::queue_overdrive_skip()
+{
+	if ( !queue_add(ONEWIRE_STEP_OVERDRIVE, 0) )
+		return false;
+	queueSteps[queueLen-1].value = 0x3C;           // Overdrive Skip ROM
+	return true;
+}
+
+bool PolledOneWire::queue_overdrive_select(const uint8_t rom[8])
+{
+	if ( queueLen + 2 > ONEWIRE_MAX_QUEUE_LEN )
+		return false;
+	queue_add(ONEWIRE_STEP_OVERDRIVE, 0);
+	queueSteps[queueLen-1].value = 0x69;           // Overdrive Match ROM
+	return queue_write(rom, 8);
+}
+
+bool PolledOneWire::queue_power(unsigned long us)
+{
+	if ( !queue_add(ONEWIRE_STEP_POWER, 0) )
+		return false;
+	queueSteps[queueLen-1].us = us;
+	return true;
+}
+
+bool PolledOneWire::queue_delay(unsigned long us)
+{
+	if ( !queue_add(ONEWIRE_STEP_DELAY, 0) )
+		return false;
+	queueSteps[queueLen-1].us = us;
+	return true;
+}
+
+void PolledOneWire::queue_start()
+{
+	queueStep = 0;
+	queueByte = 0;
+	queue_result = ONEWIRE_QUEUE_OK;
+	poll_status |= ONEWIRE_POLLSTAT_QUEUE;
+	queue_run();
+}
+
+//
+// Called whenever nothing lower level is in progress. Either continues the
+// current step or finishes it and starts the next one right away.
+//
+void PolledOneWire::queue_run()
+{
+	while ( queueStep < queueLen ) {
+		PolledOneWireStep *step = &queueSteps[queueStep];
+		switch ( step->op ) {
+		case ONEWIRE_STEP_RESET:
+			if ( queueByte == 0 ) {
+				queueByte = 1;
+				polled_reset();
+				return;
+			}
+			if ( !reset_result || overrun ) {
+				// Nobody there, or nobody can be trusted to be, so the rest of
+				// the transaction is pointless
+				queue_result = overrun ? ONEWIRE_QUEUE_OVERRUN : ONEWIRE_QUEUE_NO_PRESENCE;
+				poll_status &= ~ONEWIRE_POLLSTAT_QUEUE;
+				return;
+			}
+			break;
+		case ONEWIRE_STEP_WRITE_BYTE:
+			if ( queueByte == 0 ) {
+				queueByte = 1;
+				polled_write(step->value, step->count);
+				return;
+			}
+			break;
+		case ONEWIRE_STEP_OVERDRIVE:
+			if ( queueByte == 0 ) {
+				queueByte = 1;
+				polled_write(step->value);
+				overdrivePending = true;
+				return;
+			}
+			break;
+		case ONEWIRE_STEP_WRITE:
+		case ONEWIRE_STEP_WRITE_POWER:
+			if ( queueByte < step->count ) {
+				// Only power the bus after the last byte
+				polled_write(step->writeBuf[queueByte], step->op == ONEWIRE_STEP_WRITE_POWER
+					&& queueByte == step->count - 1);
+				queueByte++;
+				return;
+			}
+			break;
+		case ONEWIRE_STEP_SELECT:
+			if ( queueByte == 0 ) {
+				// Decided now rather than when queued, as the queue may run again
+				uint8_t command = select_command(step->writeBuf);
+				polled_write(command);
+				queueByte = command == 0xA5 ? step->count : 1;
+				return;
+			}
+			if ( queueByte < step->count ) {
+				polled_write(step->writeBuf[queueByte - 1]);
+				queueByte++;
+				return;
+			}
+			break;
+		case ONEWIRE_STEP_READ:
+			if ( queueByte > 0 )
+				step->readBuf[queueByte-1] = readWriteByte;
+			if ( queueByte < step->count ) {
+				queueByte++;
+				polled_read();
+				return;
+			}
+			break;
+		case ONEWIRE_STEP_POWER:
+		case ONEWIRE_STEP_DELAY:
+			if ( queueByte == 0 ) {
+				queueByte = 1;
+				if ( step->op == ONEWIRE_STEP_POWER ) {
+					noInterrupts();
+					DIRECT_WRITE_HIGH(baseReg, bitmask);
+					DIRECT_MODE_OUTPUT(baseReg, bitmask);	// strong pullup
+					interrupts();
+				}
+				// poll() waits this out just like the end of a bit slot
+				bitNextTime = micros();
+				bitNextTime += step->us;
+				bit_status = ONEWIRE_BITSTAT_SLOT_RECOVERY;
+				return;
+			}
+			if ( step->op == ONEWIRE_STEP_POWER )
+				depower();
+			break;
+		}
+		// This step is done, go straight on to the next one
+		queueStep++;
+		queueByte = 0;
+	}
+	poll_status &= ~ONEWIRE_POLLSTAT_QUEUE;
+}
+
+//
+// Wait for a device that signals with read slots (e.g. an externally
+// powered DS18B20 converting) to finish, by issuing a read slot every
+// interval_us until one reads as 1. When poll_status clears, ready_result
+// is true if that happened within timeout_us. Parasite powered devices
+// need the strong pullup instead, and an EEPROM copy (DS2431, DS28EC20)
+// must wait out tPROG with the bus idle, as any slot spoils it.
+//
+void PolledOneWire::polled_wait_ready(unsigned long timeout_us, unsigned int interval_us /* = 1000 */)
+{
+	readyTimeout = timeout_us;
+	readyInterval = interval_us;
+	readyStart = micros();
+	ready_result = false;
+	poll_status |= ONEWIRE_POLLSTAT_WAIT_READY;
+	readWriteByte = start_read_bit();
+	readySlot = true;
+}
+
+//
+// Read a bit and its complement, then write the bit, or direction if
+// both 0 were read. One slot per poll.
+//
+void PolledOneWire::polled_triplet(uint8_t direction)
+{
+	tripletDirection = direction;
+	triplet_result = 0;
+	poll_status |= ONEWIRE_POLLSTAT_TRIPLET;
+	if ( start_read_bit() )
+		triplet_result |= ONEWIRE_TRIPLET_ID_BIT;
+	tripletPhase = 1;
+}
+
+//
+// Read each device in roms[] in turn. The ROMs and buffers must stay valid
+// until poll_status clears.
+//
+void PolledOneWire::polled_read_batch(const uint8_t (*roms)[8], uint8_t count, uint8_t *buf,
+		uint8_t *result, uint8_t command /* = 0xBE */, uint8_t len /* = 9 */,
+		uint8_t crc_type /* = ONEWIRE_CRC_8 */)
+{
+	batchRoms = roms;
+	batchBuf = buf;
+	batchResult = result;
+	batchCount = count;
+	batchCommand = command;
+	batchLen = len;
+	batchCrcType = crc_type;
+	batchIndex = 0;
+	batchTries = 0;
+	batchEnding = false;
+	poll_status |= ONEWIRE_POLLSTAT_BATCH;
+	batch_start_device();
+}
+
+//
+// Address the next device, or finish if there are no more.
+//
+void PolledOneWire::batch_start_device()
+{
+	if ( batchIndex >= batchCount ) {
+		if ( batchCrcType == ONEWIRE_CRC_NONE && batchCount ) {
+			// The last read may have been cut short, end it with a reset.
+			// batchIndex can't count past it, a count of 255 would wrap.
+			batchEnding = true;
+			polled_reset();
+			return;
+		}
+		poll_status &= ~ONEWIRE_POLLSTAT_BATCH;
+		return;
+	}
+	queue_clear();
+	queue_reset();
+	queue_select(batchRoms[batchIndex]);
+	queue_write_byte(batchCommand);
+	queue_start();
+	batchReading = false;
+}
+
+//
+// Called once the transaction for the current device, or its read, is done.
+//
+void PolledOneWire::batch_run()
+{
+	if ( batchEnding ) {
+		// The reset after the last read is done
+		poll_status &= ~ONEWIRE_POLLSTAT_BATCH;
+		return;
+	}
+	if ( !batchReading ) {
+		if ( queue_result == ONEWIRE_QUEUE_OVERRUN ) {
+			if ( !batch_retry() )
+				batch_next(ONEWIRE_BATCH_OVERRUN);
+			return;
+		}
+		if ( queue_result != ONEWIRE_QUEUE_OK ) {
+			batch_next(ONEWIRE_BATCH_NO_PRESENCE);
+			return;
+		}
+		polled_read_into(batchBuf + (uint16_t) batchIndex * batchLen, batchLen, batchCrcType);
+		batchReading = true;
+		return;
+	}
+	if ( crc_ok || batchCrcType == ONEWIRE_CRC_NONE )
+		batch_next(ONEWIRE_BATCH_OK);
+	else if ( !batch_retry() )
+		batch_next(ONEWIRE_BATCH_CRC_ERROR);
+}
+
+//
+// Address the current device again, if it has tries left.
+//
+bool PolledOneWire::batch_retry()
+{
+	if ( batchTries >= batch_retries )
+		return false;
+	batchTries++;
+	batch_start_device();
+	return true;
+}
+
+//
+// Give the current device its result, and go on to the next.
+//
+void PolledOneWire::batch_next(uint8_t result)
+{
+	batchResult[batchIndex++] = result;
+	batchTries = 0;
+	batch_start_device();
+}
+
+#if ONEWIRE_SEARCH
+//
+// Look for the next device, like search(). When poll_status clears,
+// search_result is TRUE if a new address was found, and the address is
+// stored in readWriteBuffer[0..7].
+//
+void PolledOneWire::polled_search(bool search_mode /* = true */)
+{
+	searchState.begin(search_mode);
+	if (searchState.LastDeviceFlag) {
+		// Already found the last device, no need to touch the bus.
+		search_result = searchState.end();
+		memcpy(readWriteBuffer, searchState.ROM_NO, 8);
+		return;
+	}
+	poll_status |= ONEWIRE_POLLSTAT_SEARCH;
+	search_phase = ONEWIRE_SEARCHSTAT_RESET;
+	polled_reset();
+}
+#endif
+
+//
+// True once bitNextTime has come. With ONEWIRE_STATS, deadlines found more
+// than ONEWIRE_STATS_LATE_US late are counted as overdue: the caller didn't
+// poll often enough, and the slot or reset was stretched by that much.
+//
+bool PolledOneWire::deadline_passed()
+{
+	long late = (long) ( micros() - bitNextTime );
+
+	if ( late < 0 )
+		return false;
+#if ONEWIRE_STATS
+	if ( late > ONEWIRE_STATS_LATE_US )
+		stats.overdue++;
+#endif
+	return true;
+}
+
+#if ONEWIRE_STATS
+void PolledOneWire::stats_clear()
+{
+	memset(&stats, 0, sizeof(stats));
+	statsPolling = false;
+	statsOpPolls = 0;
+}
+
+//
+// poll() with the bookkeeping for the stats around it.
+//
+void PolledOneWire::poll()
+{
+	unsigned long start = micros();
+	unsigned long us;
+
+	if ( statsPolling && start - statsLastPoll > stats.max_gap_us )
+		stats.max_gap_us = start - statsLastPoll;
+	poll_work();
+	statsLastPoll = micros();
+	us = statsLastPoll - start;
+	stats.polls++;
+	stats.poll_us += us;
+	if ( us > stats.max_poll_us )
+		stats.max_poll_us = us;
+	statsOpPolls++;
+	statsPolling = poll_status != ONEWIRE_POLLSTAT_NONE;
+	if ( !statsPolling ) {
+		// The operation is done
+		stats.ops++;
+		stats.last_op_polls = statsOpPolls;
+		statsOpPolls = 0;
+	}
+}
+
+void PolledOneWire::poll_work()
+#else
 void PolledOneWire::poll()
+#endif
 {
 	IO_REG_TYPE mask = bitmask;
 	volatile IO_REG_TYPE *reg IO_REG_ASM = baseReg;
-	uint8_t r;
 	
 	// Note that a number of things may be happening at once. Start with lowest level
 	// things first. Note also that if one low level thing completes, don't move on to
@@ -720,43 +1699,61 @@ void PolledOneWire::poll()
 				}
 			} else {
 				// Line is high, continue
-				noInterrupts();
-				DIRECT_WRITE_LOW(reg, mask);
-				DIRECT_MODE_OUTPUT(reg, mask);	// drive output low
-				interrupts();
-				bitNextTime = micros();
-				bitNextTime += 500; // Line should stay low for 500 us
-				bit_status = ONEWIRE_BITSTAT_RESET_WAIT_LOW;
+				start_reset_pulse();
 			}
 			return;
 		}
 		if ( bit_status == ONEWIRE_BITSTAT_RESET_WAIT_LOW ) {
-			if ( (long) ( micros() - bitNextTime ) < 0 )
+			if ( !deadline_passed() )
 				return; // Not time yet
-			noInterrupts();
-			DIRECT_MODE_INPUT(reg, mask);	// allow it to float
-			delayMicroseconds(80);
-			r = !DIRECT_READ(reg, mask);
-			interrupts();			
-			reset_result = r;
+			// A late poll may have held the line low for longer, see resetOverrun
+			reset_result = critical_reset_presence();
 			bitNextTime = micros();
 			bitNextTime += 420; // Now wait 420 more us
 			bit_status = ONEWIRE_BITSTAT_RESET_WAIT_FINISH;
 			return;
 		}
 		if ( bit_status == ONEWIRE_BITSTAT_RESET_WAIT_FINISH ) {
-			if ( (long) ( micros() - bitNextTime ) < 0 )
+			if ( !deadline_passed() )
 				return; // Not time yet	
+			if ( resetOverrun ) {
+				overruns++;
+				resetOverrun = false;
+#if ONEWIRE_RESUME
+				resumeValid = false; // A power-on reset clears the RC flag
+#endif
+				if ( resetTries < ONEWIRE_OVERRUN_RETRIES ) {
+					// The line is high again after the presence pulse
+					resetTries++;
+					start_reset_pulse();
+					return;
+				}
+				overrun = true;
+			}
 			// We're done
 			poll_status &= ~ONEWIRE_POLLSTAT_RESET;
+#if ONEWIRE_RESUME
+			if ( !reset_result )
+				resumeValid = false; // Whatever was selected may have gone
+#endif
+			if ( (poll_status & ~ONEWIRE_POLLSTAT_BATCH) == ONEWIRE_POLLSTAT_QUEUE )
+				queue_run(); // Go straight on to the next step
 		}
 		return;
 	}
+	if ( bit_status == ONEWIRE_BITSTAT_SLOT_RECOVERY ) {
+		// The last bit slot is still recovering. Once it is done, carry on with this
+		// same poll; starting the next slot costs no more than the slot start itself.
+		if ( !deadline_passed() )
+			return; // Not time yet
+		bit_status = ONEWIRE_BITSTAT_NONE;
+	}
 	if ( poll_status & ONEWIRE_POLLSTAT_WRITE ) {
-		PolledOneWire::write_bit( (readWriteBitMask & readWriteByte)?1:0);
-		readWriteBitMask <<= 1;
-		if (readWriteBitMask)
+		if (readWriteBitMask) {
+			start_write_bit( (readWriteBitMask & readWriteByte)?1:0);
+			readWriteBitMask <<= 1;
 			return;
+		}
 		// We're done!
 		if ( !writePower) {
 			noInterrupts();
@@ -764,46 +1761,285 @@ void PolledOneWire::poll()
 			DIRECT_WRITE_LOW(baseReg, bitmask);
 			interrupts();		
 		}
+		if ( overdrivePending ) {
+			// An overdrive command byte just went out, switch speed
+			overdrive = true;
+			overdrivePending = false;
+		}
 		poll_status &= ~ONEWIRE_POLLSTAT_WRITE;
+		if ( (poll_status & ~ONEWIRE_POLLSTAT_BATCH) == ONEWIRE_POLLSTAT_QUEUE )
+			queue_run(); // Go straight on to the next step
 		return;
 	}
 	if ( poll_status & ONEWIRE_POLLSTAT_READ ) {
-		if ( PolledOneWire::read_bit() ) 
-			readWriteByte |= readWriteBitMask;
-		readWriteBitMask <<= 1;
-		if (readWriteBitMask)
+		if (readWriteBitMask) {
+			if ( start_read_bit() ) 
+				readWriteByte |= readWriteBitMask;
+			readWriteBitMask <<= 1;
 			return;
+		}
 		// We're done!
 		poll_status &= ~ONEWIRE_POLLSTAT_READ;
+		if ( (poll_status & ~ONEWIRE_POLLSTAT_BATCH) == ONEWIRE_POLLSTAT_QUEUE )
+			queue_run(); // Go straight on to the next step
 		return;
 	}
 	if ( poll_status & ONEWIRE_POLLSTAT_WRITE_BYTES) {
-		polled_write(readWriteBuffer[byteIndex]);
-		byteIndex++;
-		if ( byteIndex < byteCount )
+		write_next_byte();
+		return;
+	}
+	if ( poll_status & ONEWIRE_POLLSTAT_TRIPLET ) {
+		if ( tripletPhase == 1 ) {
+			if ( start_read_bit() )
+				triplet_result |= ONEWIRE_TRIPLET_CMP_BIT;
+			tripletPhase = 2;
 			return;
-		// We're done!
-		poll_status &= ~ONEWIRE_POLLSTAT_WRITE_BYTES;
-		if (!writeBytesPower) {
-			noInterrupts();
-			DIRECT_MODE_INPUT(baseReg, bitmask);
-			DIRECT_WRITE_LOW(baseReg, bitmask);
-			interrupts();
 		}
-		return;
+		if ( tripletPhase == 2 ) {
+			// Devices that agree decide the bit; if they don't, the caller does.
+			// Nobody there reads as 1 1, and writing a 1 then is harmless.
+			if ( triplet_result == 0 ) {
+				if ( tripletDirection )
+					triplet_result |= ONEWIRE_TRIPLET_DIRECTION;
+			} else if ( triplet_result != ONEWIRE_TRIPLET_CMP_BIT ) {
+				triplet_result |= ONEWIRE_TRIPLET_DIRECTION;
+			}
+			start_write_bit( (triplet_result & ONEWIRE_TRIPLET_DIRECTION) ? 1 : 0 );
+			tripletPhase = 3;
+			return;
+		}
+		// The write slot has recovered. A search goes on to its next bit in
+		// this same poll.
+		poll_status &= ~ONEWIRE_POLLSTAT_TRIPLET;
+		if ( !(poll_status & ONEWIRE_POLLSTAT_SEARCH) )
+			return;
 	}
 	if ( poll_status & ONEWIRE_POLLSTAT_READ_BYTES ) {
-		readWriteBuffer[byteIndex] = readWriteByte;
+		readPtr[byteIndex] = readWriteByte;
+#if ONEWIRE_CRC
+		if ( crcType == ONEWIRE_CRC_8 )
+			crcRunning = crc8_update(crcRunning, readWriteByte);
+#if ONEWIRE_CRC16
+		else if ( crcType == ONEWIRE_CRC_16 )
+			crcRunning = crc16_update(crcRunning, readWriteByte);
+#endif
+#endif
 		byteIndex++;
-		if (byteIndex == byteCount)
-			// We're done!
+		if (byteIndex == byteCount) {
+			// We're done! A good CRC8 over data and CRC comes to 0, a good
+			// CRC16 over data and inverted CRC to 0xB001.
 			poll_status &= ~ONEWIRE_POLLSTAT_READ_BYTES;
-		else
+			if ( crcType )
+				crc_ok = crcRunning == (crcType == ONEWIRE_CRC_8 ? 0 : 0xB001);
+		} else
 			// Get next byte
 			polled_read();
 		return;
 	}
+#if ONEWIRE_SEARCH
+	if ( poll_status & ONEWIRE_POLLSTAT_SEARCH ) {
+		switch ( search_phase ) {
+		case ONEWIRE_SEARCHSTAT_RESET:
+			if ( !reset_result ) {
+				// Nobody there, reset the search
+				search_result = searchState.end();
+				poll_status &= ~ONEWIRE_POLLSTAT_SEARCH;
+				return;
+			}
+			polled_write(searchState.command); // Issue the search command
+			search_phase = ONEWIRE_SEARCHSTAT_COMMAND;
+			return;
+		case ONEWIRE_SEARCHSTAT_COMMAND:
+			polled_triplet(searchState.direction());
+			search_phase = ONEWIRE_SEARCHSTAT_TRIPLET;
+			return;
+		case ONEWIRE_SEARCHSTAT_TRIPLET:
+			// A triplet has just finished; this poll starts the next one
+			if ( searchState.next_bit(triplet_result & ONEWIRE_TRIPLET_ID_BIT,
+					(triplet_result & ONEWIRE_TRIPLET_CMP_BIT) != 0) <= 1
+					&& !searchState.done() ) {
+				polled_triplet(searchState.direction());
+				return;
+			}
+			// All 64 bits done, or no devices answered and end() will
+			// report failure
+			search_result = searchState.end();
+			memcpy(readWriteBuffer, searchState.ROM_NO, 8);
+			poll_status &= ~ONEWIRE_POLLSTAT_SEARCH;
+			return;
+		}
+	}
+#endif
+	if ( poll_status & ONEWIRE_POLLSTAT_WAIT_READY ) {
+		if ( !readySlot ) {
+			// Waited out the interval, try again
+			readWriteByte = start_read_bit();
+			readySlot = true;
+			return;
+		}
+		// A read slot just ended
+		if ( readWriteByte ) {
+			ready_result = true;
+		} else if ( micros() - readyStart < readyTimeout ) {
+			// Still busy, wait the interval the same way as a slot recovery
+			bitNextTime = micros();
+			bitNextTime += readyInterval;
+			bit_status = ONEWIRE_BITSTAT_SLOT_RECOVERY;
+			readySlot = false;
+			return;
+		}
+		poll_status &= ~ONEWIRE_POLLSTAT_WAIT_READY;
+		return;
+	}
+	if ( poll_status & ONEWIRE_POLLSTAT_QUEUE ) {
+		queue_run();
+		return;
+	}
+	if ( poll_status & ONEWIRE_POLLSTAT_BATCH ) {
+		batch_run();
+		return;
+	}
+}
+
+
+
+#if ONEWIRE_TIMER_POLL
+
+PolledOneWire *PolledOneWire::timerInstance = 0;
+
+#if defined(__AVR__)
+// Timer2 in CTC mode, clk/32: 2 us per tick and up to 510 us at 16 MHz.
+// Parts without Timer2 (e.g. ATmega32U4) use Timer1, clk/8.
+#if defined(TCCR2A)
+#define ONEWIRE_TIMER_PRESCALE	32
+#define ONEWIRE_TIMER_MAX		255
+#else
+#define ONEWIRE_TIMER_PRESCALE	8
+#define ONEWIRE_TIMER_MAX		65535
+#endif
+
+static void onewire_timer_arm(unsigned int us)
+{
+	unsigned long ticks = ((unsigned long) us * (F_CPU / 1000000L)) / ONEWIRE_TIMER_PRESCALE;
+	if (ticks < 1) ticks = 1;
+	if (ticks > ONEWIRE_TIMER_MAX) ticks = ONEWIRE_TIMER_MAX; // Early wakeups just poll again
+#if defined(TCCR2A)
+	TCCR2A = _BV(WGM21);
+	TCCR2B = _BV(CS21) | _BV(CS20);
+	TCNT2 = 0;
+	OCR2A = ticks;
+	TIFR2 = _BV(OCF2A);
+	TIMSK2 |= _BV(OCIE2A);
+#else
+	TCCR1A = 0;
+	TCCR1B = _BV(WGM12) | _BV(CS11);
+	TCNT1 = 0;
+	OCR1A = ticks;
+	TIFR1 = _BV(OCF1A);
+	TIMSK1 |= _BV(OCIE1A);
+#endif
+}
+
+static void onewire_timer_stop()
+{
+#if defined(TCCR2A)
+	TIMSK2 &= ~_BV(OCIE2A);
+#else
+	TIMSK1 &= ~_BV(OCIE1A);
+#endif
+}
+
+#if defined(TCCR2A)
+ISR(TIMER2_COMPA_vect)
+#else
+ISR(TIMER1_COMPA_vect)
+#endif
+{
+	PolledOneWire::timer_isr();
+}
+
+#elif defined(ONEWIRE_HOST_SIM)
+static void onewire_timer_arm(unsigned int us)
+{
+	OneWireSim::timer_handler = PolledOneWire::timer_isr;
+	OneWireSim::timer_at = OneWireSim::now + us;
+	OneWireSim::timer_armed = true;
+}
+
+static void onewire_timer_stop()
+{
+	OneWireSim::timer_armed = false;
+}
+
+#elif defined(__PIC32MX__)
+// The core timer runs at half the CPU clock. chipKIT shares it between
+// services, so rather than stopping, we check back every 100 us when idle.
+#define ONEWIRE_TIMER_IDLE_US	100
+
+static volatile uint32_t onewireTimerTicks = ONEWIRE_TIMER_IDLE_US * (CORE_TICK_RATE / 1000);
+static bool onewireTimerAttached = false;
+
+static uint32_t onewire_timer_service(uint32_t now)
+{
+	PolledOneWire::timer_isr();
+	return now + onewireTimerTicks;
+}
+
+static void onewire_timer_arm(unsigned int us)
+{
+	onewireTimerTicks = us * (CORE_TICK_RATE / 1000);
+	if ( !onewireTimerAttached ) {
+		attachCoreTimerService(onewire_timer_service);
+		onewireTimerAttached = true;
+	}
+}
+
+static void onewire_timer_stop()
+{
+	onewireTimerTicks = ONEWIRE_TIMER_IDLE_US * (CORE_TICK_RATE / 1000);
+}
+
+#else
+#error "Please define a timer for ONEWIRE_TIMER_POLL here"
+#endif
+
+//
+// Hand the operation that was just started over to the timer interrupt.
+//
+void PolledOneWire::start_timer_poll()
+{
+	timerInstance = this;
+	if ( poll_status )
+		onewire_timer_arm(ONEWIRE_TIMER_MIN_US);
 }
 
+//
+// How long the timer can sleep before poll() has something to do.
+//
+unsigned int PolledOneWire::timer_poll_delay()
+{
+	long wait = (long) ( bitNextTime - micros() );
+
+	// While waiting for the line to come high after a reset we have to keep looking.
+	if ( wait < ONEWIRE_TIMER_MIN_US || bit_status == ONEWIRE_BITSTAT_RESET_WAIT_LINE_HIGH )
+		return ONEWIRE_TIMER_MIN_US;
+	if ( wait > 0xFFFF )
+		return 0xFFFF;
+	return wait;
+}
+
+void PolledOneWire::timer_isr()
+{
+	PolledOneWire *ow = timerInstance;
+
+	// poll() re-enables interrupts between its critical sections, so keep
+	// ourselves from nesting until it is done.
+	onewire_timer_stop();
+	if ( !ow || !ow->poll_status )
+		return;
+	ow->poll();
+	if ( ow->poll_status )
+		onewire_timer_arm(ow->timer_poll_delay());
+}
 
 #endif
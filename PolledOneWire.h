@@ -3,7 +3,9 @@
 
 #include <inttypes.h>
 
-#if ARDUINO >= 100
+#if defined(ONEWIRE_HOST_SIM)
+#include "PolledOneWireSim.h"
+#elif ARDUINO >= 100
 #include "Arduino.h"       // for delayMicroseconds, digitalPinToBitMask, etc
 #else
 #include "WProgram.h"      // for delayMicroseconds
@@ -45,6 +47,49 @@
 #define ONEWIRE_CRC16 1
 #endif
 
+// Select the table-lookup method of computing the 16-bit CRC by
+// setting this to 1.  Like ONEWIRE_CRC8_TABLE, the table is kept in
+// flash, but it is 512 bytes.  Worth it if you do a lot of CRC16
+// checking, e.g. DS2408 channel access or DS2431 memory reads.
+#ifndef ONEWIRE_CRC16_TABLE
+#define ONEWIRE_CRC16_TABLE 0
+#endif
+
+// You can have a hardware timer compare interrupt call poll() for you by
+// defining this to 1, so loop() only has to check poll_status. This takes
+// over Timer2 on AVR (Timer1 on parts without Timer2), which is also used
+// by tone() and analogWrite() on some pins, and the core timer on PIC32.
+// Only one PolledOneWire at a time can be timer driven.
+#ifndef ONEWIRE_TIMER_POLL
+#define ONEWIRE_TIMER_POLL 0
+#endif
+
+// select(), polled_select() and queue_select() address the device they
+// selected last with Resume (0xA5, 8 slots) rather than Match ROM (72
+// slots), if its family supports it. You can exclude that by defining this
+// to 0.
+#ifndef ONEWIRE_RESUME
+#define ONEWIRE_RESUME 1
+#endif
+
+// PolledOneWirePin<PIN> (see PolledOneWirePin.h) builds the pin into the
+// bit slots. For that, the slot primitives have to be virtual, which costs
+// every PolledOneWire a vtable pointer and an indirect call per slot, so
+// you have to allow it by defining this to 1. That changes the layout of
+// the class, so define it for the whole build (the compiler flags, e.g.
+// build_flags in PlatformIO), not in a sketch: the library and the sketch
+// must agree. If they don't, the PolledOneWire constructor they expect
+// differs, and the link fails rather than the program.
+#ifndef ONEWIRE_PIN_TEMPLATE
+#define ONEWIRE_PIN_TEMPLATE 0
+#endif
+
+// You can have PolledOneWire keep timing statistics, see the stats member,
+// by defining this to 1. It costs a few micros() calls per poll.
+#ifndef ONEWIRE_STATS
+#define ONEWIRE_STATS 0
+#endif
+
 #define FALSE 0
 #define TRUE  1
 
@@ -56,6 +101,19 @@
 #define IO_REG_TYPE uint8_t
 #define IO_REG_ASM asm("r30")
 #define DIRECT_READ(base, mask)         (((*(base)) & (mask)) ? 1 : 0)
+#define DIRECT_READ_MASK(base, mask)    ((*(base)) & (mask))
+#define DIRECT_MODE_INPUT(base, mask)   ((*(base+1)) &= ~(mask))
+#define DIRECT_MODE_OUTPUT(base, mask)  ((*(base+1)) |= (mask))
+#define DIRECT_WRITE_LOW(base, mask)    ((*(base+2)) &= ~(mask))
+#define DIRECT_WRITE_HIGH(base, mask)   ((*(base+2)) |= (mask))
+
+#elif defined(ONEWIRE_HOST_SIM)
+#define PIN_TO_BASEREG(pin)             (onewire_sim_pin_to_basereg(pin))
+#define PIN_TO_BITMASK(pin)             (onewire_sim_pin_to_bitmask(pin))
+#define IO_REG_TYPE uint8_t
+#define IO_REG_ASM
+#define DIRECT_READ(base, mask)         (((*(base)) & (mask)) ? 1 : 0)
+#define DIRECT_READ_MASK(base, mask)    ((*(base)) & (mask))
 #define DIRECT_MODE_INPUT(base, mask)   ((*(base+1)) &= ~(mask))
 #define DIRECT_MODE_OUTPUT(base, mask)  ((*(base+1)) |= (mask))
 #define DIRECT_WRITE_LOW(base, mask)    ((*(base+2)) &= ~(mask))
@@ -68,6 +126,7 @@
 #define IO_REG_TYPE uint32_t
 #define IO_REG_ASM
 #define DIRECT_READ(base, mask)         (((*(base+4)) & (mask)) ? 1 : 0)  //PORTX + 0x10
+#define DIRECT_READ_MASK(base, mask)    ((*(base+4)) & (mask))            //PORTX + 0x10
 #define DIRECT_MODE_INPUT(base, mask)   ((*(base+2)) = (mask))            //TRISXSET + 0x08
 #define DIRECT_MODE_OUTPUT(base, mask)  ((*(base+1)) = (mask))            //TRISXCLR + 0x04
 #define DIRECT_WRITE_LOW(base, mask)    ((*(base+8+1)) = (mask))          //LATXCLR  + 0x24
@@ -77,6 +136,153 @@
 #error "Please define I/O register types here"
 #endif
 
+// The timing critical parts of a bus cycle, done with interrupts disabled.
+// These are always inlined, so when reg and mask are compile time constants
+// (see PolledOneWirePin.h) each register access folds to a single
+// instruction.
+
+// Start a write slot: drive the line low and let it go once the bit is
+// written. The rest of the slot is recovery time, see write_recovery().
+static inline __attribute__((always_inline))
+void onewire_write_slot(volatile IO_REG_TYPE *reg, IO_REG_TYPE mask, uint8_t v, bool overdrive)
+{
+	noInterrupts();
+	DIRECT_WRITE_LOW(reg, mask);
+	DIRECT_MODE_OUTPUT(reg, mask);	// drive output low
+	if (overdrive)
+		delayMicroseconds((v & 1) ? 1 : 8);
+	else
+		delayMicroseconds((v & 1) ? 10 : 65);
+	DIRECT_WRITE_HIGH(reg, mask);	// drive output high
+	interrupts();
+}
+
+// Start a read slot and sample the bit. The rest of the slot is recovery
+// time, 53 us (7 us at overdrive speed).
+static inline __attribute__((always_inline))
+uint8_t onewire_read_slot(volatile IO_REG_TYPE *reg, IO_REG_TYPE mask, bool overdrive)
+{
+	uint8_t r;
+
+	noInterrupts();
+	DIRECT_MODE_OUTPUT(reg, mask);
+	DIRECT_WRITE_LOW(reg, mask);
+	delayMicroseconds(overdrive ? 1 : 3);
+	DIRECT_MODE_INPUT(reg, mask);	// let pin float, pull up will raise
+	delayMicroseconds(overdrive ? 1 : 10);
+	r = DIRECT_READ(reg, mask);
+	interrupts();
+	return r;
+}
+
+// The longest a standard speed reset low may last. Devices may take a
+// longer one for a power-on reset; lower it if a data sheet gives a shorter
+// maximum.
+#ifndef ONEWIRE_RESET_LOW_MAX_US
+#define ONEWIRE_RESET_LOW_MAX_US		960
+#endif
+
+// End the reset pulse and sample the presence pulse. At standard speed the
+// line has already been low for 500 us, since lowStart; *overrun tells
+// whether that was longer than ONEWIRE_RESET_LOW_MAX_US, checked with
+// interrupts already off so nothing can stretch it afterwards. At overdrive
+// speed the low time has a maximum, so the whole 70 us pulse is done here.
+// Either way the bus has to be left alone for 420 us (40 us at overdrive
+// speed) afterwards.
+static inline __attribute__((always_inline))
+uint8_t onewire_reset_presence(volatile IO_REG_TYPE *reg, IO_REG_TYPE mask, bool overdrive,
+		unsigned long lowStart, bool *overrun)
+{
+	uint8_t r;
+
+	noInterrupts();
+	if (overdrive) {
+		DIRECT_WRITE_LOW(reg, mask);
+		DIRECT_MODE_OUTPUT(reg, mask);	// drive output low
+		delayMicroseconds(70);
+		*overrun = false;
+	} else
+		*overrun = (unsigned long) (micros() - lowStart) > ONEWIRE_RESET_LOW_MAX_US;
+	DIRECT_MODE_INPUT(reg, mask);	// allow it to float
+	delayMicroseconds(overdrive ? 8 : 80);
+	r = !DIRECT_READ(reg, mask);
+	interrupts();
+	return r;
+}
+
+// One step of a queued transaction, see queue_start()
+struct PolledOneWireStep
+{
+	uint8_t op;
+#define ONEWIRE_STEP_RESET				0
+#define ONEWIRE_STEP_WRITE_BYTE			1
+#define ONEWIRE_STEP_WRITE				2
+#define ONEWIRE_STEP_WRITE_POWER		3
+#define ONEWIRE_STEP_READ				4
+#define ONEWIRE_STEP_POWER				5
+#define ONEWIRE_STEP_DELAY				6
+#define ONEWIRE_STEP_OVERDRIVE			7
+#define ONEWIRE_STEP_SELECT				8
+	uint8_t count;
+	union {
+		const uint8_t *writeBuf;
+		uint8_t *readBuf;
+		unsigned long us;
+		uint8_t value;
+	};
+};
+
+#if ONEWIRE_SEARCH
+// The bookkeeping of the 1-Wire search (Maxim Application Note 187):
+// the ROM found so far, and which branch to take at each bit. The master
+// using it drives the bus, and feeds it each bit and its complement read.
+// Shared by PolledOneWire and PolledDS2482.
+class PolledOneWireSearch
+{
+  public:
+	unsigned char ROM_NO[8];
+	uint8_t LastDiscrepancy;
+	uint8_t LastFamilyDiscrepancy;
+	uint8_t LastDeviceFlag;
+	uint8_t command; // Search ROM (0xF0) or Conditional Search (0xEC)
+
+	void reset();
+	void target(uint8_t family_code);
+	void family_skip();
+	void begin(bool search_mode); // Start a pass
+	uint8_t direction(); // The way to go if devices differ at the current bit
+	uint8_t next_bit(uint8_t id_bit, uint8_t cmp_id_bit); // The bit to write, 2 if nobody answered
+	bool done() { return bitNumber > 64; }
+	uint8_t end(); // TRUE if the pass found a device, its ROM is in ROM_NO
+
+  private:
+	uint8_t bitNumber;
+	uint8_t lastZero;
+	uint8_t romByteNumber;
+	uint8_t romByteMask;
+};
+#endif
+
+#if ONEWIRE_STATS
+// Timing statistics, all times in microseconds
+struct PolledOneWireStats
+{
+	unsigned long polls;			// Calls to poll()
+	unsigned long poll_us;			// Total time spent inside poll()
+	unsigned long max_poll_us;		// Longest single poll()
+	unsigned long critical_us;		// Total time with interrupts disabled
+	unsigned long max_critical_us;	// Longest time with interrupts disabled
+	unsigned long max_gap_us;		// Longest time between polls while busy
+	unsigned long overdue;			// Deadlines found more than ONEWIRE_STATS_LATE_US late
+	unsigned long ops;				// Operations polled to completion
+	unsigned long last_op_polls;	// Polls the last operation took
+};
+#endif
+
+#if ONEWIRE_PIN_TEMPLATE
+// Only there to give the constructor a different link name in this build
+struct PolledOneWirePinTemplate {};
+#endif
 
 class PolledOneWire
 {
@@ -86,14 +292,16 @@ class PolledOneWire
 
 #if ONEWIRE_SEARCH
     // global search state
-    unsigned char ROM_NO[8];
-    uint8_t LastDiscrepancy;
-    uint8_t LastFamilyDiscrepancy;
-    uint8_t LastDeviceFlag;
+    PolledOneWireSearch searchState;
 #endif
 
   public:
+#if ONEWIRE_PIN_TEMPLATE
+    PolledOneWire( uint8_t pin, PolledOneWirePinTemplate = PolledOneWirePinTemplate());
+    virtual ~PolledOneWire() {}
+#else
     PolledOneWire( uint8_t pin);
+#endif
 
     // Perform a 1-Wire reset cycle. Returns 1 if a device responds
     // with a presence pulse.  Returns 0 if there is no device or the
@@ -103,9 +311,30 @@ class PolledOneWire
     // Issue a 1-Wire rom select command, you do the reset first.
     void select( uint8_t rom[8]);
 
+#if ONEWIRE_RESUME
+    // Forget the device selected last, so the next select of it uses
+    // Match ROM again. Only needed if it may have lost power, or another
+    // master may have used the bus, since.
+    void resume_clear();
+
+    // True if devices of this family answer Resume.
+    static bool resume_supported(uint8_t family_code);
+#endif
+
     // Issue a 1-Wire rom skip command, to address all on bus.
     void skip(void);
 
+    // Overdrive Skip ROM and Overdrive Match ROM. The command byte is sent
+    // at standard speed, everything after it at overdrive speed, which is
+    // about 8 times faster. Only devices that support overdrive follow;
+    // set overdrive back to false and reset() to return to standard speed.
+    void overdrive_skip(void);
+    void overdrive_select( uint8_t rom[8]);
+
+    // True while talking at overdrive speed. Affects all of the blocking
+    // and polled functions.
+    bool overdrive;
+
     // Write a byte. If 'power' is one then the wire is held high at
     // the end for parasitically powered devices. You are responsible
     // for eventually depowering it by calling depower() or doing
@@ -143,7 +372,23 @@ class PolledOneWire
     // might be a good idea to check the CRC to make sure you didn't
     // get garbage.  The order is deterministic. You will always get
     // the same devices in the same order.
-    uint8_t search(uint8_t *newAddr);
+    // With search_mode false, only devices in an alarm condition
+    // answer (Conditional Search, 0xEC).
+    uint8_t search(uint8_t *newAddr, bool search_mode = true);
+
+    // Set up the search state so the next search() finds the first
+    // device of this family, if there is one. The devices after it
+    // follow in order, so stop once the family code of the ROM found
+    // is no longer family_code.
+    void target_search(uint8_t family_code);
+
+    // Set up the search state so the next search() skips the rest of
+    // the family of the device it last found.
+    void family_skip_search();
+
+    // Check that the device with this ROM is on the bus, with a single
+    // search pass. The search state is left as it was.
+    bool verify(const uint8_t rom[8]);
 #endif
 
 #if ONEWIRE_CRC
@@ -151,6 +396,9 @@ class PolledOneWire
     // ROM and scratchpad registers.
     static uint8_t crc8( uint8_t *addr, uint8_t len);
 
+    // Add one byte to a running 8 bit CRC.
+    static uint8_t crc8_update( uint8_t crc, uint8_t inbyte);
+
 #if ONEWIRE_CRC16
     // Compute the 1-Wire CRC16 and compare it against the received CRC.
     // Example usage (reading a DS2408):
@@ -185,6 +433,9 @@ class PolledOneWire
     // @param len - How many bytes to use.
     // @return The CRC16, as defined by Dallas Semiconductor.
     static uint16_t crc16(uint8_t* input, uint16_t len);
+
+    // Add one byte to a running 16 bit CRC.
+    static uint16_t crc16_update(uint16_t crc, uint8_t inbyte);
 #endif
 #endif
 
@@ -198,9 +449,63 @@ class PolledOneWire
 	void polled_skip();
 	void polled_write_bytes(const uint8_t *buf, uint8_t count, bool power = 0);
 	void polled_select( uint8_t rom[8] );
-	void polled_read_bytes(uint8_t count);
+#define ONEWIRE_CRC_NONE				0
+#define ONEWIRE_CRC_8					1
+#define ONEWIRE_CRC_16					2
+	void polled_read_bytes(uint8_t count, uint8_t crc_type = ONEWIRE_CRC_NONE);
+	void polled_write_from(const uint8_t *buf, uint16_t count, bool power = 0); // No copy, buf must stay valid
+	void polled_read_into(uint8_t *buf, uint16_t count, uint8_t crc_type = ONEWIRE_CRC_NONE,
+		uint16_t crc_seed = 0); // Result in buf rather than readWriteBuffer
+	void polled_overdrive_skip();
+	void polled_overdrive_select( uint8_t rom[8] );
+	void polled_wait_ready(unsigned long timeout_us, unsigned int interval_us = 1000); // Result in ready_result
+	void polled_triplet(uint8_t direction); // Result in triplet_result
+	void polled_read_batch(const uint8_t (*roms)[8], uint8_t count, uint8_t *buf, uint8_t *result,
+		uint8_t command = 0xBE, uint8_t len = 9,
+		uint8_t crc_type = ONEWIRE_CRC_8); // Device i in buf[i * len], result[i]
+#define ONEWIRE_BATCH_OK				0
+#define ONEWIRE_BATCH_NO_PRESENCE		1
+#define ONEWIRE_BATCH_CRC_ERROR			2
+#define ONEWIRE_BATCH_OVERRUN			3
+	uint8_t batch_retries; // Times a device is read again after a CRC error or overrun, 1 by default
+#if ONEWIRE_SEARCH
+	void polled_search(bool search_mode = true); // Result in search_result, ROM in readWriteBuffer[0..7]
+#endif
 	
 	void poll(); // Call this as long as poll_status != 0
+
+#if ONEWIRE_STATS
+#ifndef ONEWIRE_STATS_LATE_US
+#define ONEWIRE_STATS_LATE_US			50
+#endif
+	PolledOneWireStats stats;
+	void stats_clear();
+#endif
+
+	// Transaction queue. Queue up the steps of a whole transaction, then
+	// queue_start() and poll() as usual; poll() moves from one step to the next
+	// by itself. Buffers passed in must stay valid until poll_status clears.
+	// The queue_*() calls return false if the queue is full.
+#ifndef ONEWIRE_MAX_QUEUE_LEN
+#define ONEWIRE_MAX_QUEUE_LEN			8
+#endif
+	void queue_clear();
+	bool queue_reset(); // Ends the transaction early if no device is present
+	bool queue_write_byte(uint8_t v, uint8_t power = 0);
+	bool queue_write(const uint8_t *buf, uint8_t count, bool power = 0);
+	bool queue_read(uint8_t *buf, uint8_t count);
+	bool queue_skip();
+	bool queue_select(const uint8_t rom[8]);
+	bool queue_overdrive_skip();
+	bool queue_overdrive_select(const uint8_t rom[8]);
+	bool queue_power(unsigned long us); // Strong pullup for us microseconds, then depower
+	bool queue_delay(unsigned long us);
+	void queue_start();
+
+#if ONEWIRE_TIMER_POLL
+	void start_timer_poll(); // Or call this once after starting an operation
+	static void timer_isr();
+#endif
 	
 	// It's bad OOP practice to expose variables like this, but I figure it is better
 	// to do so and check externally if polling is needed than make a function call and waste time.
@@ -208,16 +513,47 @@ class PolledOneWire
 	// This is the overall poll status, used to determine what needs to be done, and if we need
 	// to be polled.
 
-	uint8_t poll_status;
+#if ONEWIRE_TIMER_POLL
+	volatile uint16_t poll_status;
+#else
+	uint16_t poll_status;
+#endif
 #define ONEWIRE_POLLSTAT_NONE 			0x00
 #define ONEWIRE_POLLSTAT_RESET 			0x01
 #define ONEWIRE_POLLSTAT_WRITE 			0x02
 #define ONEWIRE_POLLSTAT_READ 			0x04
 #define ONEWIRE_POLLSTAT_WRITE_BYTES	0x08
 #define ONEWIRE_POLLSTAT_READ_BYTES		0x10		
+#define ONEWIRE_POLLSTAT_SEARCH			0x20
+#define ONEWIRE_POLLSTAT_QUEUE			0x40
+#define ONEWIRE_POLLSTAT_WAIT_READY		0x80
+#define ONEWIRE_POLLSTAT_TRIPLET		0x100
+#define ONEWIRE_POLLSTAT_BATCH			0x200
 	
 	bool reset_result; // Return result of reset. True = devices present. False = devices not present.
+
+	// A polled reset whose line was held low longer than
+	// ONEWIRE_RESET_LOW_MAX_US (see above), because poll() came late, is done
+	// again, up to ONEWIRE_OVERRUN_RETRIES times.
+#ifndef ONEWIRE_OVERRUN_RETRIES
+#define ONEWIRE_OVERRUN_RETRIES			2
+#endif
+	bool overrun; // The last polled reset was still held too long after its retries
+	unsigned long overruns; // Resets held too long, retried or not
 	uint8_t readWriteByte; // Used for read and write. Only for Read should this be accessed.
+	bool crc_ok; // Result of the CRC check of a polled read, if one was asked for
+	bool ready_result; // Result of polled_wait_ready(). True = device answered with a 1.
+	uint8_t triplet_result; // Return result of polled_triplet()
+#define ONEWIRE_TRIPLET_ID_BIT			0x01 // The bit read
+#define ONEWIRE_TRIPLET_CMP_BIT			0x02 // Its complement read
+#define ONEWIRE_TRIPLET_DIRECTION		0x04 // The bit written
+	uint8_t queue_result; // Return result of a queued transaction
+#define ONEWIRE_QUEUE_OK				0
+#define ONEWIRE_QUEUE_NO_PRESENCE		1
+#define ONEWIRE_QUEUE_OVERRUN			2
+#if ONEWIRE_SEARCH
+	uint8_t search_result; // Return result of polled_search(). TRUE = new device in readWriteBuffer.
+#endif
 	
 	// Don't increase this beyond 256! We're using a single byte as an index.
 	// Don't decrease this to less than 9, otherwise polled_select() will fail.
@@ -229,16 +565,115 @@ class PolledOneWire
   private:
 	unsigned long bitNextTime;
 	uint8_t bit_status;
-#define ONEWIRE_BITSTAT_RESET_NONE						0
+	uint8_t resetTries;
+	bool overdrivePending; // Switch to overdrive once the current byte is written
+#if ONEWIRE_RESUME
+	uint8_t resumeRom[8];
+	bool resumeValid; // resumeRom was selected last, and only it answers Resume
+	bool romCommandNext; // The next byte written is a ROM command
+	void rom_command(uint8_t v);
+#endif
+	uint8_t select_command(const uint8_t rom[8]);
+#define ONEWIRE_BITSTAT_NONE							0
 #define ONEWIRE_BITSTAT_RESET_WAIT_LINE_HIGH			1
 #define ONEWIRE_BITSTAT_RESET_WAIT_LOW					2
 #define ONEWIRE_BITSTAT_RESET_WAIT_FINISH				3
+#define ONEWIRE_BITSTAT_SLOT_RECOVERY					4 // Also used for queued delays
+
+	// Polled bit slots. These do only the timing-critical start of a slot with
+	// interrupts disabled, then leave the rest of the slot to poll().
+	void start_write_bit(uint8_t v);
+	uint8_t start_read_bit();
+	void start_reset_pulse();
+	uint8_t write_recovery(uint8_t v);
+	uint8_t read_recovery();
+	void critical_write_slot(uint8_t v);
+	uint8_t critical_read_slot();
+	uint8_t critical_reset_presence();
+	bool deadline_passed();
+#if ONEWIRE_STATS
+	bool statsPolling;
+	unsigned long statsLastPoll;
+	unsigned long statsOpPolls;
+	void stats_critical(unsigned long start);
+	void poll_work();
+#endif
+
+  protected:
+	// The timing critical parts of a reset and of the bit slots, see
+	// onewire_write_slot() and friends. With ONEWIRE_PIN_TEMPLATE,
+	// PolledOneWirePin overrides these with versions that have the pin
+	// built in.
+	unsigned long resetLowStart; // When the reset pulse in progress pulled the line low
+	bool resetOverrun; // It was held low too long, set by reset_presence()
+#if ONEWIRE_PIN_TEMPLATE
+	virtual void write_slot(uint8_t v);
+	virtual uint8_t read_slot();
+	virtual uint8_t reset_presence();
+#else
+	void write_slot(uint8_t v);
+	uint8_t read_slot();
+	uint8_t reset_presence();
+#endif
+
+  private:
+
+#if ONEWIRE_TIMER_POLL
+	static PolledOneWire *timerInstance;
+	unsigned int timer_poll_delay();
+#ifndef ONEWIRE_TIMER_MIN_US
+#define ONEWIRE_TIMER_MIN_US							10
+#endif
+#endif
 
 	uint8_t readWriteBitMask;
 	uint8_t writePower;
 	uint8_t writeBytesPower; // Needed because we only turn on parasitic power at the end of the string
-	uint8_t byteCount;
-	uint8_t byteIndex;
+	uint16_t byteCount;
+	uint16_t byteIndex;
+	const uint8_t *writePtr;
+	uint8_t *readPtr;
+	uint8_t crcType;
+	uint16_t crcRunning;
+
+	unsigned long readyStart;
+	unsigned long readyTimeout;
+	unsigned int readyInterval;
+	bool readySlot; // A read slot is in progress rather than the wait between them
+	void write_next_byte();
+
+	PolledOneWireStep queueSteps[ONEWIRE_MAX_QUEUE_LEN];
+	uint8_t queueLen;
+	uint8_t queueStep;
+	uint8_t queueByte;
+	bool queue_add(uint8_t op, uint8_t count);
+	void queue_run();
+
+	uint8_t tripletPhase;
+	uint8_t tripletDirection;
+
+	const uint8_t (*batchRoms)[8];
+	uint8_t *batchBuf;
+	uint8_t *batchResult;
+	uint8_t batchCount;
+	uint8_t batchIndex;
+	uint8_t batchCommand;
+	uint8_t batchLen;
+	uint8_t batchCrcType;
+	bool batchReading; // The read of the current device is in progress, rather than addressing it
+	bool batchEnding; // The reset after the last read is in progress
+	uint8_t batchTries;
+	void batch_start_device();
+	bool batch_retry();
+	void batch_next(uint8_t result);
+	void batch_run();
+
+#if ONEWIRE_SEARCH
+	uint8_t search_phase;
+#define ONEWIRE_SEARCHSTAT_RESET						0
+#define ONEWIRE_SEARCHSTAT_COMMAND						1
+#define ONEWIRE_SEARCHSTAT_TRIPLET						2
+#endif
 };
 
 #endif
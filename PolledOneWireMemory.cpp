@@ -0,0 +1,434 @@
+/*
+Polled 1-Wire memory reader and EEPROM writer. See PolledOneWireMemory.h.
+Same copyright and license as PolledOneWire.cpp.
+
+Addressing the device is a queued transaction (reset, Match ROM, the read
+command and address, and the read of the command CRC if the family sends
+one). Each page is then a polled_read_into() of the page and its CRC,
+checked on the fly. The device goes on to the next page by itself, so
+there is no reset or ROM between pages unless a CRC was bad. poll() moves
+on to the next step when the bus goes idle, so it has the same delays as
+PolledOneWire::poll().
+
+The DS250x_PROM example reads a page with 32 blocking read() calls.
+
+Writing a block is three queued transactions: reset, Match ROM, Write
+Scratchpad and the CRC16 read; reset, Match ROM and Read Scratchpad; and
+reset, Match ROM, Copy Scratchpad with power on after the E/S byte,
+queue_power() for tPROG, and the read of the status byte. Each is checked
+in next() before the next one starts, so a bad scratchpad is never copied.
+*/
+
+#include "PolledOneWireMemory.h"
+
+#if ONEWIRE_CRC && ONEWIRE_CRC16
+
+
+// Family code, pages, read command, CRC after the command, CRC after each
+// page, scratchpad size for write()
+static const uint8_t PROGMEM memory_families[][6] = {
+	{ 0x09,  4, 0xC3, ONEWIRE_CRC_8,    ONEWIRE_CRC_8,     0 },	// DS2502
+	{ 0x0B, 64, 0xF0, ONEWIRE_CRC_16,   ONEWIRE_CRC_NONE,  0 },	// DS2505
+	{ 0x23, 16, 0xF0, ONEWIRE_CRC_NONE, ONEWIRE_CRC_NONE,  0 },	// DS2433
+	{ 0x2D,  4, 0xF0, ONEWIRE_CRC_NONE, ONEWIRE_CRC_NONE,  8 },	// DS2431
+	{ 0x43, 80, 0xA5, ONEWIRE_CRC_NONE, ONEWIRE_CRC_16,   32 },	// DS28EC20
+};
+
+static const uint8_t *memory_family( uint8_t family_code )
+{
+	for ( uint8_t i = 0; i < sizeof(memory_families) / sizeof(memory_families[0]); i++ )
+		if ( pgm_read_byte(&memory_families[i][0]) == family_code )
+			return memory_families[i];
+	return NULL;
+}
+
+PolledOneWireMemory::PolledOneWireMemory( PolledOneWire *ow )
+{
+	this->ow = ow;
+	status = ONEWIRE_MEMORY_IDLE;
+	result = ONEWIRE_MEMORY_OK;
+	retries = 2;
+	pages_read = 0;
+	blocks_written = 0;
+	errors = 0;
+}
+
+uint8_t PolledOneWireMemory::page_count( uint8_t family_code )
+{
+	const uint8_t *f = memory_family(family_code);
+
+	return f ? pgm_read_byte(f + 1) : 0;
+}
+
+uint8_t PolledOneWireMemory::block_size( uint8_t family_code )
+{
+	const uint8_t *f = memory_family(family_code);
+
+	return f ? pgm_read_byte(f + 5) : 0;
+}
+
+bool PolledOneWireMemory::read( const uint8_t rom[8], PolledOneWireMemoryCallback callback,
+	uint8_t first_page /* = 0 */, uint8_t pages /* = 0 */ )
+{
+	const uint8_t *f = memory_family(rom[0]);
+	uint8_t count;
+
+	if ( status != ONEWIRE_MEMORY_IDLE || !f )
+		return false;
+	count = pgm_read_byte(f + 1);
+	if ( first_page >= count )
+		return false;
+	if ( !pages )
+		pages = count - first_page;
+	if ( pages > count - first_page )
+		return false;
+
+	this->rom = rom;
+	this->callback = callback;
+	command = pgm_read_byte(f + 2);
+	commandCrc = pgm_read_byte(f + 3);
+	pageCrc = pgm_read_byte(f + 4);
+	page = first_page;
+	endPage = first_page + pages;
+	tries = 0;
+	result = ONEWIRE_MEMORY_OK;
+	address();
+	return true;
+}
+
+//
+// Reset, Match ROM, and the read command at the current page.
+//
+void PolledOneWireMemory::address()
+{
+	uint16_t addr = page * ONEWIRE_MEMORY_PAGE_SIZE;
+
+	commandBuf[0] = command;
+	commandBuf[1] = addr & 0xFF;
+	commandBuf[2] = addr >> 8;
+	ow->queue_clear();
+	ow->queue_reset();
+	ow->queue_select(rom);
+	ow->queue_write(commandBuf, 3);
+	if ( commandCrc )
+		ow->queue_read(commandBuf + 3, commandCrc == ONEWIRE_CRC_8 ? 1 : 2);
+	ow->queue_start();
+	firstPage = true;
+	status = ONEWIRE_MEMORY_ADDRESS;
+	started();
+}
+
+//
+// Read the page and the CRC after it, if any. A CRC16 on the first page
+// after addressing also covers the command and address.
+//
+void PolledOneWireMemory::read_page()
+{
+	uint8_t len = ONEWIRE_MEMORY_PAGE_SIZE;
+	uint16_t seed = 0;
+
+	if ( pageCrc == ONEWIRE_CRC_8 )
+		len += 1;
+	else if ( pageCrc == ONEWIRE_CRC_16 ) {
+		len += 2;
+		if ( firstPage )
+			seed = PolledOneWire::crc16(commandBuf, 3);
+	}
+	ow->polled_read_into(buf, len, pageCrc, seed);
+	firstPage = false;
+	status = ONEWIRE_MEMORY_READ;
+	started();
+}
+
+//
+// A page is in, or couldn't be read. After a bad CRC the device is out of
+// step, so it is addressed again at the page to read next.
+//
+void PolledOneWireMemory::page_done( bool ok )
+{
+	if ( !ok ) {
+		errors++;
+		if ( tries < retries ) {
+			tries++;
+			address();
+			return;
+		}
+		result = ONEWIRE_MEMORY_CRC_ERROR;
+	} else {
+		pages_read++;
+	}
+	if ( callback )
+		callback(page, buf, ok);
+	page++;
+	tries = 0;
+	if ( page >= endPage )
+		end();
+	else if ( ok )
+		read_page();
+	else
+		address();
+}
+
+//
+// The command CRC was bad, so no page was read: don't pass on what is left
+// in buf from the one before.
+//
+void PolledOneWireMemory::address_failed()
+{
+	memset(buf, 0xFF, sizeof(buf));
+	page_done(false);
+}
+
+bool PolledOneWireMemory::write( const uint8_t rom[8], uint16_t addr, const uint8_t *data, uint16_t len )
+{
+	uint8_t block = block_size(rom[0]);
+
+	if ( status != ONEWIRE_MEMORY_IDLE )
+		return false;
+	if ( !block || !len || addr % block || len % block )
+		return false;
+	if ( (uint32_t) addr + len > (uint32_t) page_count(rom[0]) * ONEWIRE_MEMORY_PAGE_SIZE )
+		return false;
+
+	this->rom = rom;
+	writeData = data;
+	writeAddress = addr;
+	writeEnd = addr + len;
+	blockSize = block;
+	tries = 0;
+	result = ONEWIRE_MEMORY_OK;
+	write_scratchpad();
+	return true;
+}
+
+//
+// Write Scratchpad. Writing up to its end makes the device send the CRC16
+// of the command, address and data.
+//
+void PolledOneWireMemory::write_scratchpad()
+{
+	commandBuf[0] = 0x0F;
+	commandBuf[1] = writeAddress & 0xFF;
+	commandBuf[2] = writeAddress >> 8;
+	ow->queue_clear();
+	ow->queue_reset();
+	ow->queue_select(rom);
+	ow->queue_write(commandBuf, 3);
+	ow->queue_write(writeData, blockSize);
+	ow->queue_read(buf, 2);
+	ow->queue_start();
+	status = ONEWIRE_MEMORY_WRITE;
+	started();
+}
+
+//
+// Read Scratchpad: the address, E/S, the data and a CRC16 of it all.
+//
+void PolledOneWireMemory::read_scratchpad()
+{
+	ow->queue_clear();
+	ow->queue_reset();
+	ow->queue_select(rom);
+	ow->queue_write_byte(0xAA);
+	ow->queue_read(buf, 3 + blockSize + 2);
+	ow->queue_start();
+	status = ONEWIRE_MEMORY_VERIFY;
+	started();
+}
+
+//
+// Copy Scratchpad, authorized with the address and E/S just read back.
+// The device takes its programming current from the strong pullup, and
+// answers read slots with 0xAA once the copy is done.
+//
+void PolledOneWireMemory::copy_scratchpad()
+{
+	commandBuf[0] = 0x55;
+	memcpy(commandBuf + 1, buf, 3);
+	ow->queue_clear();
+	ow->queue_reset();
+	ow->queue_select(rom);
+	ow->queue_write(commandBuf, 4, 1);
+	ow->queue_power(ONEWIRE_MEMORY_TPROG_US);
+	ow->queue_read(buf, 1);
+	ow->queue_start();
+	status = ONEWIRE_MEMORY_COPY;
+	started();
+}
+
+//
+// Start the block over from Write Scratchpad, or give up on the write.
+//
+void PolledOneWireMemory::block_failed( uint8_t error )
+{
+	errors++;
+	if ( tries < retries ) {
+		tries++;
+		write_scratchpad();
+		return;
+	}
+	result = error;
+	end();
+}
+
+//
+// The reset of the last transaction was held low too long, even after
+// PolledOneWire retried it, so the device may have taken it as a power-on
+// reset. Do the step again from the start, or give up.
+//
+void PolledOneWireMemory::overran()
+{
+	errors++;
+	if ( tries < retries ) {
+		tries++;
+		if ( status == ONEWIRE_MEMORY_ADDRESS )
+			address();
+		else
+			write_scratchpad();
+		return;
+	}
+	result = ONEWIRE_MEMORY_OVERRUN;
+	end();
+}
+
+//
+// Reset the bus, so the device stops sending.
+//
+void PolledOneWireMemory::end()
+{
+	ow->polled_reset();
+	status = ONEWIRE_MEMORY_END;
+	started();
+}
+
+//
+// Let the timer interrupt poll the bus if that is how it is polled.
+//
+void PolledOneWireMemory::started()
+{
+#if ONEWIRE_TIMER_POLL
+	ow->start_timer_poll();
+#endif
+}
+
+void PolledOneWireMemory::poll()
+{
+	if ( ow->poll_status ) {
+#if !ONEWIRE_TIMER_POLL
+		ow->poll();
+#endif
+		return;
+	}
+	next();
+}
+
+//
+// The bus is idle, so the current step is done.
+//
+void PolledOneWireMemory::next()
+{
+	switch ( status ) {
+	case ONEWIRE_MEMORY_ADDRESS:
+		if ( ow->queue_result == ONEWIRE_QUEUE_OVERRUN ) {
+			overran();
+			return;
+		}
+		if ( ow->queue_result != ONEWIRE_QUEUE_OK ) {
+			result = ONEWIRE_MEMORY_NO_PRESENCE;
+			break;
+		}
+		if ( commandCrc == ONEWIRE_CRC_8 ) {
+			if ( PolledOneWire::crc8(commandBuf, 3) != commandBuf[3] ) {
+				address_failed();
+				return;
+			}
+		} else if ( commandCrc == ONEWIRE_CRC_16 ) {
+			if ( !PolledOneWire::check_crc16(commandBuf, 3, commandBuf + 3) ) {
+				address_failed();
+				return;
+			}
+		}
+		read_page();
+		return;
+	case ONEWIRE_MEMORY_READ:
+		page_done(!pageCrc || ow->crc_ok);
+		return;
+	case ONEWIRE_MEMORY_WRITE: {
+		uint16_t crc;
+
+		if ( ow->queue_result == ONEWIRE_QUEUE_OVERRUN ) {
+			overran();
+			return;
+		}
+		if ( ow->queue_result != ONEWIRE_QUEUE_OK ) {
+			result = ONEWIRE_MEMORY_NO_PRESENCE;
+			break;
+		}
+		crc = PolledOneWire::crc16(commandBuf, 3);
+		for ( uint8_t i = 0; i < blockSize; i++ )
+			crc = PolledOneWire::crc16_update(crc, writeData[i]);
+		crc = ~crc;
+		if ( buf[0] != (crc & 0xFF) || buf[1] != (crc >> 8) ) {
+			block_failed(ONEWIRE_MEMORY_VERIFY_ERROR);
+			return;
+		}
+		read_scratchpad();
+		return;
+	}
+	case ONEWIRE_MEMORY_VERIFY: {
+		uint16_t crc = PolledOneWire::crc16_update(0, 0xAA);
+
+		if ( ow->queue_result == ONEWIRE_QUEUE_OVERRUN ) {
+			overran();
+			return;
+		}
+		if ( ow->queue_result != ONEWIRE_QUEUE_OK ) {
+			result = ONEWIRE_MEMORY_NO_PRESENCE;
+			break;
+		}
+		for ( uint8_t i = 0; i < 3 + blockSize; i++ )
+			crc = PolledOneWire::crc16_update(crc, buf[i]);
+		crc = ~crc;
+		// E/S is the last offset written, with the partial (PF) and
+		// authorization (AA) flags clear
+		if ( buf[3 + blockSize] != (crc & 0xFF) || buf[4 + blockSize] != (crc >> 8)
+			|| buf[0] != commandBuf[1] || buf[1] != commandBuf[2] || buf[2] != blockSize - 1
+			|| memcmp(buf + 3, writeData, blockSize) ) {
+			block_failed(ONEWIRE_MEMORY_VERIFY_ERROR);
+			return;
+		}
+		copy_scratchpad();
+		return;
+	}
+	case ONEWIRE_MEMORY_COPY:
+		if ( ow->queue_result == ONEWIRE_QUEUE_OVERRUN ) {
+			overran();
+			return;
+		}
+		if ( ow->queue_result != ONEWIRE_QUEUE_OK ) {
+			result = ONEWIRE_MEMORY_NO_PRESENCE;
+			break;
+		}
+		if ( buf[0] != 0xAA ) {
+			block_failed(ONEWIRE_MEMORY_COPY_ERROR);
+			return;
+		}
+		blocks_written++;
+		writeData += blockSize;
+		writeAddress += blockSize;
+		tries = 0;
+		if ( writeAddress >= writeEnd ) {
+			end();
+			return;
+		}
+		write_scratchpad();
+		return;
+	case ONEWIRE_MEMORY_END:
+		break;
+	default:
+		return;
+	}
+	status = ONEWIRE_MEMORY_IDLE;
+}
+
+#endif // ONEWIRE_CRC && ONEWIRE_CRC16
@@ -0,0 +1,146 @@
+#ifndef PolledOneWireMemory_h
+#define PolledOneWireMemory_h
+
+#include "PolledOneWire.h"
+
+#if ONEWIRE_CRC && ONEWIRE_CRC16
+
+// Memory reader and EEPROM writer for 1-Wire memory devices on a
+// PolledOneWire bus.
+//
+// read() streams whole 32-byte pages out of a device with one memory read
+// command: the device is addressed once, and then sends page after page
+// for as long as they are read. Each page is passed to the callback as
+// soon as it is in, with ok telling whether its CRC was good.
+//
+// What can be checked depends on the family, and is kept in a table:
+//
+//   0x09 DS2502    4 pages  Read Data/Generate 8-bit CRC (0xC3): command
+//                           CRC8, and a CRC8 after each page
+//   0x0B DS2505   64 pages  Read Memory (0xF0): command CRC16 only
+//   0x23 DS2433   16 pages  Read Memory (0xF0): no CRC at all
+//   0x2D DS2431    4 pages  Read Memory (0xF0): no CRC at all
+//   0x43 DS28EC20 80 pages  Extended Read Memory (0xA5): a CRC16 after
+//                           each page, the first one also covering the
+//                           command and address
+//
+// The CRCs are checked on the fly by the polled reads. A page or command
+// with a bad CRC is read again, addressing the device at that page, up to
+// retries times; after that it is passed on with ok false, and the read
+// goes on with the next page. With ok false the data can't be trusted: it
+// is the page as it was read, or all 0xFF if the command CRC was bad and
+// nothing was read.
+//
+// write() programs DS2431 and DS28EC20 EEPROMs, a scratchpad at a time
+// (8 and 32 bytes): Write Scratchpad, checked against the CRC16 the device
+// sends back, Read Scratchpad to verify the data, address and E/S byte,
+// then Copy Scratchpad with the strong pullup held for tPROG, and the 0xAA
+// the device answers with once the copy is done. A block that fails any
+// of these is written again, up to retries times; after that the write
+// stops.
+//
+// Nothing may happen on the bus while a device programs, not even to
+// other devices, so scratchpads can't be loaded during another device's
+// tPROG. poll() does no work at all then, though, so the caller's own work
+// goes on, and devices on separate PolledOneWire buses, each with its own
+// PolledOneWireMemory, program at the same time.
+//
+// If a transaction stops because its reset overran (see
+// PolledOneWire::overrun), the device may have taken it for a power-on
+// reset, so the read is addressed again at the same page, or the block is
+// written again from Write Scratchpad. This counts as one of the retries;
+// when they run out, result is ONEWIRE_MEMORY_OVERRUN.
+//
+// None of it blocks: call poll() while status != 0. A read or write ends
+// with a reset, and result then tells how it went.
+//
+// The CRC checks need ONEWIRE_CRC and ONEWIRE_CRC16; without them there is
+// no PolledOneWireMemory.
+
+#define ONEWIRE_MEMORY_PAGE_SIZE		32
+
+#ifndef ONEWIRE_MEMORY_TPROG_US
+#define ONEWIRE_MEMORY_TPROG_US		10000
+#endif
+
+typedef void (*PolledOneWireMemoryCallback)( uint8_t page, const uint8_t *data, bool ok );
+
+class PolledOneWireMemory
+{
+  public:
+	PolledOneWireMemory( PolledOneWire *ow );
+
+	// Number of pages of a family, 0 if it isn't in the table
+	static uint8_t page_count( uint8_t family_code );
+	// Scratchpad size of a family, 0 if write() doesn't support it
+	static uint8_t block_size( uint8_t family_code );
+
+	// Read pages first_page on, all the rest if pages is 0. No copy of rom,
+	// it must stay valid. Returns false if the family isn't in the table,
+	// the pages aren't all there, or a read or write is still in progress.
+	bool read( const uint8_t rom[8], PolledOneWireMemoryCallback callback,
+		uint8_t first_page = 0, uint8_t pages = 0 );
+	// Write len bytes at addr, both multiples of block_size(). No copy
+	// of rom or data, they must stay valid. Returns false if the family
+	// can't be written, the range isn't right, or a read or write is still
+	// in progress.
+	bool write( const uint8_t rom[8], uint16_t addr, const uint8_t *data, uint16_t len );
+	void poll(); // Call this as long as status != 0
+
+	uint8_t status;
+#define ONEWIRE_MEMORY_IDLE				0
+#define ONEWIRE_MEMORY_ADDRESS			1
+#define ONEWIRE_MEMORY_READ				2
+#define ONEWIRE_MEMORY_END				3
+#define ONEWIRE_MEMORY_WRITE			4
+#define ONEWIRE_MEMORY_VERIFY			5
+#define ONEWIRE_MEMORY_COPY				6
+
+	uint8_t result; // Of the last read() or write(), once status is idle
+#define ONEWIRE_MEMORY_OK				0
+#define ONEWIRE_MEMORY_NO_PRESENCE		1
+#define ONEWIRE_MEMORY_CRC_ERROR		2 // At least one page passed on with ok false
+#define ONEWIRE_MEMORY_VERIFY_ERROR		3 // A scratchpad couldn't be loaded, the write stopped there
+#define ONEWIRE_MEMORY_COPY_ERROR		4 // A copy wasn't confirmed, the write stopped there
+#define ONEWIRE_MEMORY_OVERRUN			5 // Resets kept overrunning (see PolledOneWire::overrun), it stopped there
+
+	uint8_t retries; // Times a page or block is done again after an error or overrun, 2 by default
+	unsigned long pages_read; // Pages passed on with ok true
+	unsigned long blocks_written; // Scratchpads copied to memory
+	unsigned long errors; // Bad CRCs, failed blocks and overruns, including ones a retry fixed
+
+  private:
+	PolledOneWire *ow;
+	const uint8_t *rom;
+	PolledOneWireMemoryCallback callback;
+	uint8_t page;
+	uint8_t endPage;
+	uint8_t tries;
+	uint8_t command;
+	uint8_t commandCrc; // ONEWIRE_CRC_* after the command and address
+	uint8_t pageCrc; // ONEWIRE_CRC_* after each page
+	bool firstPage; // The page right after addressing
+	uint8_t commandBuf[5]; // Command, address, and its CRC or E/S
+	uint8_t buf[3 + ONEWIRE_MEMORY_PAGE_SIZE + 2]; // A page and its CRC, or a scratchpad read
+	const uint8_t *writeData; // The block being written
+	uint16_t writeAddress;
+	uint16_t writeEnd;
+	uint8_t blockSize;
+
+	void address();
+	void read_page();
+	void page_done( bool ok );
+	void address_failed();
+	void write_scratchpad();
+	void read_scratchpad();
+	void copy_scratchpad();
+	void block_failed( uint8_t error );
+	void overran();
+	void end();
+	void started();
+	void next();
+};
+
+#endif // ONEWIRE_CRC && ONEWIRE_CRC16
+
+#endif
@@ -0,0 +1,337 @@
+/*
+Polled OneWire lock-step multi-line engine. See PolledOneWireMulti.h.
+Same copyright and license as PolledOneWire.cpp.
+
+Timing is the same as for the polled functions of PolledOneWire, except
+that each slot is done on all lines at once:
+
+polled_reset() - No delay. One poll has 80 us delay, after which the member
+variable reset_result has a bit set for each line with a device present.
+Lines that don't come high within 250 us are left out of the reset.
+
+polled_write() / polled_write_bytes() / polled_select() - Each poll that
+starts a bit has 10 us delay if all lines write a 1, 65 us if any writes a 0.
+
+polled_read() / polled_read_bytes() - Each poll that starts a bit has 13 us
+delay.
+
+This is a separate engine rather than a PolledOneWire with a wider bitmask:
+every slot here carries per-line data in and out (a byte per line, a
+presence bit per line, two release times in one write slot), while the
+single-line slots, CRC, search and queue of PolledOneWire work on one byte.
+Sharing the code would put per-line loops into the single-line slots.
+*/
+
+#include "PolledOneWireMulti.h"
+
+
+PolledOneWireMulti::PolledOneWireMulti( const uint8_t *pins, uint8_t count )
+{
+	if (count > ONEWIRE_MULTI_MAX_LINES)
+		count = ONEWIRE_MULTI_MAX_LINES;
+	lineCount = count;
+	bitmask = 0;
+	lines_ok = 0;
+	baseReg = PIN_TO_BASEREG(pins[0]);
+	for (uint8_t i = 0; i < count; i++) {
+		if (PIN_TO_BASEREG(pins[i]) == baseReg) {
+			pinMode(pins[i], INPUT);
+			lineMask[i] = PIN_TO_BITMASK(pins[i]);
+			bitmask |= lineMask[i];
+			lines_ok |= (onewire_multi_lines_t) 1 << i;
+		} else {
+			lineMask[i] = 0;	// Different port, can't be driven with the others
+		}
+	}
+	stuckMask = 0;
+	slotMask = bitmask;
+	poll_status = ONEWIRE_POLLSTAT_NONE;
+	bit_status = ONEWIRE_BITSTAT_NONE;
+}
+
+void PolledOneWireMulti::depower()
+{
+	noInterrupts();
+	DIRECT_MODE_INPUT(baseReg, bitmask);
+	DIRECT_WRITE_LOW(baseReg, bitmask);
+	interrupts();
+}
+
+//
+// Drive the lines in mask low to start the reset pulse.
+//
+void PolledOneWireMulti::start_reset_low(IO_REG_TYPE mask)
+{
+	noInterrupts();
+	DIRECT_WRITE_LOW(baseReg, mask);
+	DIRECT_MODE_OUTPUT(baseReg, mask);	// drive output low
+	interrupts();
+	bitNextTime = micros();
+	bitNextTime += 500; // Line should stay low for 500 us
+	bit_status = ONEWIRE_BITSTAT_RESET_WAIT_LOW;
+}
+
+void PolledOneWireMulti::polled_reset()
+{
+	poll_status |= ONEWIRE_POLLSTAT_RESET;
+	reset_result = 0;
+	stuckMask = 0;
+	slotMask = bitmask;
+
+	noInterrupts();
+	DIRECT_MODE_INPUT(baseReg, bitmask);
+	interrupts();
+
+	// All lines should be high. If not, wait up to 250 us.
+	if ( DIRECT_READ_MASK(baseReg, bitmask) == bitmask ) {
+		start_reset_low(bitmask);
+	} else {
+		bitNextTime = micros();
+		bitNextTime += 250;
+		bit_status = ONEWIRE_BITSTAT_RESET_WAIT_LINE_HIGH;
+	}
+}
+
+//
+// Start a write slot on all lines, each line writing bit readWriteBitMask of
+// its readWriteByte[].
+//
+void PolledOneWireMulti::start_write_bits()
+{
+	IO_REG_TYPE ones = 0;
+
+	for (uint8_t i = 0; i < lineCount; i++)
+		if (readWriteByte[i] & readWriteBitMask)
+			ones |= lineMask[i];
+	ones &= slotMask;
+
+	noInterrupts();
+	DIRECT_WRITE_LOW(baseReg, slotMask);
+	DIRECT_MODE_OUTPUT(baseReg, slotMask);	// drive output low
+	delayMicroseconds(10);
+	DIRECT_WRITE_HIGH(baseReg, ones);	// lines writing a 1 go high
+	if (ones != slotMask) {
+		delayMicroseconds(55);
+		DIRECT_WRITE_HIGH(baseReg, slotMask);	// and now the rest
+		interrupts();
+		bitNextTime = micros();
+		bitNextTime += 5; // Remainder of the slot
+	} else {
+		interrupts();
+		bitNextTime = micros();
+		bitNextTime += 55; // Remainder of the slot
+	}
+	bit_status = ONEWIRE_BITSTAT_SLOT_RECOVERY;
+	readWriteBitMask <<= 1;
+}
+
+//
+// Start a read slot on all lines and sample them all at once.
+//
+void PolledOneWireMulti::start_read_bits()
+{
+	IO_REG_TYPE r;
+
+	noInterrupts();
+	DIRECT_MODE_OUTPUT(baseReg, slotMask);
+	DIRECT_WRITE_LOW(baseReg, slotMask);
+	delayMicroseconds(3);
+	DIRECT_MODE_INPUT(baseReg, slotMask);	// let pins float, pull ups will raise
+	delayMicroseconds(10);
+	r = DIRECT_READ_MASK(baseReg, slotMask);
+	interrupts();
+	bitNextTime = micros();
+	bitNextTime += 53; // Remainder of the slot
+	bit_status = ONEWIRE_BITSTAT_SLOT_RECOVERY;
+
+	for (uint8_t i = 0; i < lineCount; i++)
+		if ( (r & lineMask[i]) || !(slotMask & lineMask[i]) )
+			readWriteByte[i] |= readWriteBitMask;
+	readWriteBitMask <<= 1;
+}
+
+void PolledOneWireMulti::polled_write(uint8_t v, uint8_t power /* = 0 */)
+{
+	for (uint8_t i = 0; i < lineCount; i++)
+		readWriteByte[i] = v;
+	writePower = power;
+	poll_status |= ONEWIRE_POLLSTAT_WRITE;
+	readWriteBitMask = 0x01;
+	start_write_bits();
+}
+
+void PolledOneWireMulti::polled_read()
+{
+	for (uint8_t i = 0; i < lineCount; i++)
+		readWriteByte[i] = 0;
+	poll_status |= ONEWIRE_POLLSTAT_READ;
+	readWriteBitMask = 0x01;
+	start_read_bits();
+}
+
+void PolledOneWireMulti::polled_skip()
+{
+	polled_write(0xCC);           // Skip ROM
+}
+
+//
+// Load the next byte of each line's buffer and start writing it.
+//
+void PolledOneWireMulti::write_next_byte()
+{
+	for (uint8_t i = 0; i < lineCount; i++)
+		readWriteByte[i] = writeBufs[i][byteIndex];
+	byteIndex++;
+	// Only power the bus after the last byte
+	writePower = writeBytesPower && byteIndex == byteCount;
+	poll_status |= ONEWIRE_POLLSTAT_WRITE;
+	readWriteBitMask = 0x01;
+	start_write_bits();
+}
+
+void PolledOneWireMulti::polled_write_bytes(const uint8_t *buf, uint8_t count, bool power /* = 0 */)
+{
+	if ( !count )
+		return;
+	for (uint8_t i = 0; i < lineCount; i++)
+		writeBufs[i] = buf;
+	byteCount = count;
+	byteIndex = 0;
+	writeBytesPower = power;
+	poll_status |= ONEWIRE_POLLSTAT_WRITE_BYTES;
+	write_next_byte();
+}
+
+void PolledOneWireMulti::polled_write_bytes(const uint8_t * const *bufs, uint8_t count, bool power /* = 0 */)
+{
+	if ( !count )
+		return;
+	for (uint8_t i = 0; i < lineCount; i++)
+		writeBufs[i] = bufs[i];
+	byteCount = count;
+	byteIndex = 0;
+	writeBytesPower = power;
+	poll_status |= ONEWIRE_POLLSTAT_WRITE_BYTES;
+	write_next_byte();
+}
+
+//
+// Do a ROM select, each line with its own ROM. The ROMs are read as they are
+// written, so they must stay valid until poll_status clears.
+//
+void PolledOneWireMulti::polled_select( const uint8_t * const *roms )
+{
+	for (uint8_t i = 0; i < lineCount; i++)
+		writeBufs[i] = roms[i];
+	byteCount = 8;
+	byteIndex = 0;
+	writeBytesPower = 0;
+	poll_status |= ONEWIRE_POLLSTAT_WRITE_BYTES;
+	polled_write(0x55);           // Choose ROM, then the ROMs follow from poll()
+}
+
+void PolledOneWireMulti::polled_read_bytes(uint8_t * const *bufs, uint8_t count)
+{
+	if ( !count )
+		return;
+	for (uint8_t i = 0; i < lineCount; i++)
+		readBufs[i] = bufs[i];
+	byteCount = count;
+	byteIndex = 0;
+	poll_status |= ONEWIRE_POLLSTAT_READ_BYTES;
+	polled_read();
+}
+
+void PolledOneWireMulti::poll()
+{
+	IO_REG_TYPE r;
+
+	if ( poll_status & ONEWIRE_POLLSTAT_RESET ) {
+		// We're in the middle of a Reset
+		if ( bit_status == ONEWIRE_BITSTAT_RESET_WAIT_LINE_HIGH ) {
+			r = DIRECT_READ_MASK(baseReg, bitmask);
+			if ( r == bitmask ) {
+				start_reset_low(bitmask);
+			} else if ( (long) ( micros() - bitNextTime ) >= 0 ) {
+				// Give up on the lines that are still low
+				stuckMask = bitmask & ~r;
+				slotMask = r;
+				if ( r )
+					start_reset_low(r);
+				else
+					poll_status &= ~ONEWIRE_POLLSTAT_RESET;
+			}
+			return;
+		}
+		if ( bit_status == ONEWIRE_BITSTAT_RESET_WAIT_LOW ) {
+			if ( (long) ( micros() - bitNextTime ) < 0 )
+				return; // Not time yet
+			noInterrupts();
+			DIRECT_MODE_INPUT(baseReg, bitmask);	// allow them to float
+			delayMicroseconds(80);
+			r = DIRECT_READ_MASK(baseReg, bitmask);
+			interrupts();
+			for (uint8_t i = 0; i < lineCount; i++)
+				if ( lineMask[i] && !(r & lineMask[i]) && !(stuckMask & lineMask[i]) )
+					reset_result |= (onewire_multi_lines_t) 1 << i;
+			bitNextTime = micros();
+			bitNextTime += 420; // Now wait 420 more us
+			bit_status = ONEWIRE_BITSTAT_RESET_WAIT_FINISH;
+			return;
+		}
+		if ( bit_status == ONEWIRE_BITSTAT_RESET_WAIT_FINISH ) {
+			if ( (long) ( micros() - bitNextTime ) < 0 )
+				return; // Not time yet
+			// We're done
+			bit_status = ONEWIRE_BITSTAT_NONE;
+			poll_status &= ~ONEWIRE_POLLSTAT_RESET;
+		}
+		return;
+	}
+	if ( bit_status == ONEWIRE_BITSTAT_SLOT_RECOVERY ) {
+		if ( (long) ( micros() - bitNextTime ) < 0 )
+			return; // Not time yet
+		bit_status = ONEWIRE_BITSTAT_NONE;
+	}
+	if ( poll_status & ONEWIRE_POLLSTAT_WRITE ) {
+		if (readWriteBitMask) {
+			start_write_bits();
+			return;
+		}
+		// We're done!
+		if ( !writePower )
+			depower();
+		poll_status &= ~ONEWIRE_POLLSTAT_WRITE;
+		return;
+	}
+	if ( poll_status & ONEWIRE_POLLSTAT_READ ) {
+		if (readWriteBitMask) {
+			start_read_bits();
+			return;
+		}
+		// We're done!
+		poll_status &= ~ONEWIRE_POLLSTAT_READ;
+		return;
+	}
+	if ( poll_status & ONEWIRE_POLLSTAT_WRITE_BYTES ) {
+		if ( byteIndex < byteCount ) {
+			write_next_byte();
+			return;
+		}
+		// We're done! polled_write() already depowered unless asked not to.
+		poll_status &= ~ONEWIRE_POLLSTAT_WRITE_BYTES;
+		return;
+	}
+	if ( poll_status & ONEWIRE_POLLSTAT_READ_BYTES ) {
+		for (uint8_t i = 0; i < lineCount; i++)
+			readBufs[i][byteIndex] = readWriteByte[i];
+		byteIndex++;
+		if (byteIndex == byteCount)
+			// We're done!
+			poll_status &= ~ONEWIRE_POLLSTAT_READ_BYTES;
+		else
+			// Get next byte
+			polled_read();
+		return;
+	}
+}
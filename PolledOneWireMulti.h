@@ -0,0 +1,87 @@
+#ifndef PolledOneWireMulti_h
+#define PolledOneWireMulti_h
+
+#include "PolledOneWire.h"
+
+// Several 1-Wire lines on the same I/O port, driven in lock-step.
+//
+// Every bit slot is done on all lines at once with single register writes
+// using a combined bitmask, and all lines are sampled with one port read, so
+// N parallel strings of sensors take the bus time of one. Each line can send
+// different data: in a write slot the lines writing a 1 are let go after
+// 10 us, the lines writing a 0 after 65 us.
+//
+// Pins that are not on the same port as the first pin can't be driven
+// together; they are left out, and their bit in lines_ok is clear. Lines
+// that are still low when a reset starts are left out of it and of every
+// slot until the next reset, and read as 1s.
+//
+// The polled interface follows PolledOneWire: start an operation, then call
+// poll() while poll_status != 0. Per-line data is passed as an array of
+// buffer pointers, one per line, in the order the pins were given.
+
+#ifndef ONEWIRE_MULTI_MAX_LINES
+#define ONEWIRE_MULTI_MAX_LINES 8
+#endif
+
+// One bit per line in lines_ok and reset_result
+#if ONEWIRE_MULTI_MAX_LINES <= 8
+typedef uint8_t onewire_multi_lines_t;
+#elif ONEWIRE_MULTI_MAX_LINES <= 16
+typedef uint16_t onewire_multi_lines_t;
+#elif ONEWIRE_MULTI_MAX_LINES <= 32
+typedef uint32_t onewire_multi_lines_t;
+#else
+#error "ONEWIRE_MULTI_MAX_LINES can be at most 32"
+#endif
+
+class PolledOneWireMulti
+{
+  private:
+	IO_REG_TYPE bitmask;	// all usable lines
+	volatile IO_REG_TYPE *baseReg;
+	IO_REG_TYPE lineMask[ONEWIRE_MULTI_MAX_LINES];
+	uint8_t lineCount;
+
+  public:
+	PolledOneWireMulti( const uint8_t *pins, uint8_t count );
+
+	onewire_multi_lines_t lines_ok; // Bit i set if pin i shares the port and is driven
+
+	void polled_reset(); // Initiates a reset on all lines
+	void polled_write(uint8_t v, uint8_t power = 0); // Same byte on all lines
+	void polled_read(); // One byte from each line into readWriteByte[]
+	void polled_skip();
+	void polled_write_bytes(const uint8_t *buf, uint8_t count, bool power = 0); // Same bytes on all lines
+	void polled_write_bytes(const uint8_t * const *bufs, uint8_t count, bool power = 0); // bufs[i] to line i
+	void polled_select( const uint8_t * const *roms ); // roms[i] selected on line i
+	void polled_read_bytes(uint8_t * const *bufs, uint8_t count); // count bytes from line i into bufs[i]
+	void depower();
+
+	void poll(); // Call this as long as poll_status != 0
+
+	uint8_t poll_status; // Same ONEWIRE_POLLSTAT_* values as PolledOneWire
+	onewire_multi_lines_t reset_result; // Bit i set if a device answered on line i
+	uint8_t readWriteByte[ONEWIRE_MULTI_MAX_LINES]; // Per line, result of polled_read()
+
+  private:
+	unsigned long bitNextTime;
+	uint8_t bit_status; // Same ONEWIRE_BITSTAT_* values as PolledOneWire
+	IO_REG_TYPE stuckMask; // Lines that never came high before a reset
+	IO_REG_TYPE slotMask; // Lines the slots are done on: bitmask without stuckMask
+
+	uint8_t readWriteBitMask;
+	uint8_t writePower;
+	uint8_t writeBytesPower;
+	uint8_t byteCount;
+	uint8_t byteIndex;
+	const uint8_t *writeBufs[ONEWIRE_MULTI_MAX_LINES];
+	uint8_t *readBufs[ONEWIRE_MULTI_MAX_LINES];
+
+	void start_reset_low(IO_REG_TYPE mask);
+	void start_write_bits();
+	void start_read_bits();
+	void write_next_byte();
+};
+
+#endif
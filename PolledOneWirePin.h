@@ -0,0 +1,62 @@
+#ifndef PolledOneWirePin_h
+#define PolledOneWirePin_h
+
+#include "PolledOneWire.h"
+
+// PolledOneWire with the pin fixed at compile time:
+//
+//    PolledOneWirePin<10> ds;
+//
+// instead of PolledOneWire ds(10). It is used exactly the same way, and
+// shares all of its code, except for the timing critical parts of the bit
+// slots and the reset pulse. In those, the port registers and bitmask are
+// constants, so every register access is a single instruction (sbi/cbi on
+// AVR) rather than a load through a pointer. This makes the interrupts
+// disabled windows a little shorter and their timing a little tighter.
+//
+// Those parts are virtual functions of PolledOneWire, which only they are
+// with ONEWIRE_PIN_TEMPLATE defined to 1, for the library as well as the
+// sketch: define it in the build flags, not in the sketch, or the link
+// fails (see PolledOneWire.h). The compile time pin map is only known for the ATmega8, 88, 168
+// and 328 (Uno, Duemilanove, Nano, Pro Mini); on other boards use
+// PolledOneWire.
+
+#if !ONEWIRE_PIN_TEMPLATE
+#error "PolledOneWirePin needs ONEWIRE_PIN_TEMPLATE defined to 1"
+#endif
+
+// Compile time versions of PIN_TO_BASEREG() and PIN_TO_BITMASK(), as
+// constant expressions of the pin number.
+#if defined(__AVR_ATmega328P__) || defined(__AVR_ATmega328__) || defined(__AVR_ATmega168__) \
+	|| defined(__AVR_ATmega168P__) || defined(__AVR_ATmega88__) || defined(__AVR_ATmega8__)
+// Arduino Uno, Duemilanove, Nano, Pro Mini etc: 0-7 PORTD, 8-13 PORTB, 14-19 PORTC
+#define ONEWIRE_PIN_TO_BASEREG(pin)     ((pin) < 8 ? &PIND : (pin) < 14 ? &PINB : &PINC)
+#define ONEWIRE_PIN_TO_BITMASK(pin)     ((pin) < 8 ? _BV(pin) : (pin) < 14 ? _BV((pin) - 8) : _BV((pin) - 14))
+#elif defined(ONEWIRE_HOST_SIM)
+// The host simulation has no fixed addresses, but the same code path is used
+#define ONEWIRE_PIN_TO_BASEREG(pin)     (onewire_sim_pin_to_basereg(pin))
+#define ONEWIRE_PIN_TO_BITMASK(pin)     (onewire_sim_pin_to_bitmask(pin))
+#else
+#error "PolledOneWirePin has no compile time pin map for this board, use PolledOneWire"
+#endif
+
+template <uint8_t PIN>
+class PolledOneWirePin : public PolledOneWire
+{
+  public:
+	PolledOneWirePin() : PolledOneWire(PIN) {}
+
+  protected:
+	void write_slot(uint8_t v) {
+		onewire_write_slot(ONEWIRE_PIN_TO_BASEREG(PIN), ONEWIRE_PIN_TO_BITMASK(PIN), v, overdrive);
+	}
+	uint8_t read_slot() {
+		return onewire_read_slot(ONEWIRE_PIN_TO_BASEREG(PIN), ONEWIRE_PIN_TO_BITMASK(PIN), overdrive);
+	}
+	uint8_t reset_presence() {
+		return onewire_reset_presence(ONEWIRE_PIN_TO_BASEREG(PIN), ONEWIRE_PIN_TO_BITMASK(PIN), overdrive,
+			resetLowStart, &resetOverrun);
+	}
+};
+
+#endif
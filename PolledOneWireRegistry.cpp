@@ -0,0 +1,239 @@
+/*
+Polled OneWire device registry. See PolledOneWireRegistry.h.
+Same copyright and license as PolledOneWire.cpp.
+*/
+
+#include "PolledOneWireRegistry.h"
+
+#if ONEWIRE_CRC
+
+#if ONEWIRE_REGISTRY_EEPROM && !defined(ONEWIRE_HOST_SIM)
+#include <avr/eeprom.h>
+#endif
+
+// Saved tables start with these two bytes, then the count, the ROMs and a
+// CRC8 of the count and ROMs.
+#define ONEWIRE_REGISTRY_MAGIC0		'O'
+#define ONEWIRE_REGISTRY_MAGIC1		'W'
+
+
+PolledOneWireRegistry::PolledOneWireRegistry()
+{
+	clear();
+}
+
+void PolledOneWireRegistry::clear()
+{
+	count = 0;
+	overflow = false;
+}
+
+//
+// ROMs are ordered byte by byte, family code first.
+//
+int8_t PolledOneWireRegistry::compare( const uint8_t *a, const uint8_t *b )
+{
+	for (uint8_t i = 0; i < 8; i++) {
+		if (a[i] != b[i])
+			return a[i] < b[i] ? -1 : 1;
+	}
+	return 0;
+}
+
+//
+// Index of the first entry that is not less than r.
+//
+uint8_t PolledOneWireRegistry::lower_bound( const uint8_t r[8] )
+{
+	uint8_t lo = 0, hi = count;
+
+	while (lo < hi) {
+		uint8_t mid = (lo + hi) / 2;
+		if (compare(rom[mid], r) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+bool PolledOneWireRegistry::add( const uint8_t r[8] )
+{
+	uint8_t i;
+
+	if (PolledOneWire::crc8((uint8_t *) r, 7) != r[7])
+		return false;
+	i = lower_bound(r);
+	if (i < count && compare(rom[i], r) == 0)
+		return true; // Already there
+	if (count >= ONEWIRE_REGISTRY_MAX_DEVICES)
+		return false;
+	memmove(rom[i + 1], rom[i], (count - i) * 8);
+	memmove(&flags[i + 1], &flags[i], count - i);
+	memcpy(rom[i], r, 8);
+	flags[i] = 0;
+	count++;
+	return true;
+}
+
+bool PolledOneWireRegistry::remove( const uint8_t r[8] )
+{
+	int16_t i = find(r);
+
+	if (i < 0)
+		return false;
+	count--;
+	memmove(rom[i], rom[i + 1], (count - i) * 8);
+	memmove(&flags[i], &flags[i + 1], count - i);
+	return true;
+}
+
+int16_t PolledOneWireRegistry::find( const uint8_t r[8] )
+{
+	uint8_t i = lower_bound(r);
+
+	if (i < count && compare(rom[i], r) == 0)
+		return i;
+	return -1;
+}
+
+uint8_t PolledOneWireRegistry::family_first( uint8_t family )
+{
+	uint8_t r[8] = { family, 0, 0, 0, 0, 0, 0, 0 };
+
+	return lower_bound(r);
+}
+
+uint8_t PolledOneWireRegistry::family_count( uint8_t family )
+{
+	uint8_t r[8] = { (uint8_t) (family + 1), 0, 0, 0, 0, 0, 0, 0 };
+
+	// The family ends where the next one would start
+	if (family == 0xFF)
+		return count - family_first(family);
+	return lower_bound(r) - family_first(family);
+}
+
+#if ONEWIRE_SEARCH
+uint8_t PolledOneWireRegistry::scan( PolledOneWire *ow )
+{
+	uint8_t addr[8];
+
+	clear();
+	ow->reset_search();
+	while (ow->search(addr))
+		if (!add(addr) && count >= ONEWIRE_REGISTRY_MAX_DEVICES)
+			overflow = true;
+	ow->reset_search();
+	return count;
+}
+
+//
+// Everything known is missing until the search finds it again. A search
+// that fails part way ends the same way as one that found the last
+// device, so if the bus is disturbed during rescan() devices can be
+// flagged missing that are still there: check them again with verify()
+// before acting on it.
+//
+uint8_t PolledOneWireRegistry::rescan( PolledOneWire *ow )
+{
+	uint8_t addr[8];
+	uint8_t changes = 0;
+	int16_t i;
+
+	for (i = 0; i < count; i++)
+		flags[i] = ONEWIRE_REGISTRY_MISSING;
+	overflow = false;
+	ow->reset_search();
+	while (ow->search(addr)) {
+		i = find(addr);
+		if (i >= 0) {
+			flags[i] &= ~ONEWIRE_REGISTRY_MISSING;
+		} else if (add(addr)) {
+			flags[find(addr)] = ONEWIRE_REGISTRY_NEW;
+		} else if (count >= ONEWIRE_REGISTRY_MAX_DEVICES) {
+			// New, but the table is full
+			overflow = true;
+			changes++;
+		}
+	}
+	ow->reset_search();
+	for (i = 0; i < count; i++)
+		if (flags[i])
+			changes++;
+	return changes;
+}
+#endif
+
+void PolledOneWireRegistry::purge()
+{
+	uint8_t j = 0;
+
+	for (uint8_t i = 0; i < count; i++) {
+		if (flags[i] & ONEWIRE_REGISTRY_MISSING)
+			continue;
+		if (i != j)
+			memcpy(rom[j], rom[i], 8);
+		flags[j++] = 0;
+	}
+	count = j;
+}
+
+#if ONEWIRE_REGISTRY_EEPROM
+static uint8_t registry_eeprom_read( int address )
+{
+	return eeprom_read_byte((const uint8_t *) (uintptr_t) address);
+}
+
+static void registry_eeprom_update( int address, uint8_t value )
+{
+	if (registry_eeprom_read(address) != value)
+		eeprom_write_byte((uint8_t *) (uintptr_t) address, value);
+}
+
+void PolledOneWireRegistry::save( int address )
+{
+	uint8_t crc = PolledOneWire::crc8_update(0, count);
+
+	registry_eeprom_update(address++, ONEWIRE_REGISTRY_MAGIC0);
+	registry_eeprom_update(address++, ONEWIRE_REGISTRY_MAGIC1);
+	registry_eeprom_update(address++, count);
+	for (uint8_t i = 0; i < count; i++) {
+		for (uint8_t j = 0; j < 8; j++) {
+			registry_eeprom_update(address++, rom[i][j]);
+			crc = PolledOneWire::crc8_update(crc, rom[i][j]);
+		}
+	}
+	registry_eeprom_update(address, crc);
+}
+
+bool PolledOneWireRegistry::load( int address )
+{
+	uint8_t n, crc;
+	uint8_t r[8];
+
+	clear();
+	if (registry_eeprom_read(address++) != ONEWIRE_REGISTRY_MAGIC0
+			|| registry_eeprom_read(address++) != ONEWIRE_REGISTRY_MAGIC1)
+		return false;
+	n = registry_eeprom_read(address++);
+	if (n > ONEWIRE_REGISTRY_MAX_DEVICES)
+		return false;
+	crc = PolledOneWire::crc8_update(0, n);
+	for (uint8_t i = 0; i < n; i++) {
+		for (uint8_t j = 0; j < 8; j++) {
+			r[j] = registry_eeprom_read(address++);
+			crc = PolledOneWire::crc8_update(crc, r[j]);
+		}
+		// Through add(), so a bad entry can't break the sort
+		add(r);
+	}
+	if (registry_eeprom_read(address) != crc) {
+		clear();
+		return false;
+	}
+	return true;
+}
+#endif
+
+#endif // ONEWIRE_CRC
@@ -0,0 +1,102 @@
+#ifndef PolledOneWireRegistry_h
+#define PolledOneWireRegistry_h
+
+#include "PolledOneWire.h"
+
+#if ONEWIRE_CRC
+
+// A table of the ROMs on a bus, for buses with too many devices to keep
+// each address in its own variable.
+//
+// ROMs are added from search() (or polled_search()), CRC checked, and kept
+// sorted, so find() is a binary search, and all devices of one family are
+// next to each other: family_first() and family_count() give their range.
+// The table can be saved to and loaded from EEPROM, so a sketch can skip
+// the full search at boot.
+//
+// After devices are plugged in or out, rescan() brings the table up to
+// date and flags what changed: new ROMs are added with
+// ONEWIRE_REGISTRY_NEW set, ROMs that didn't answer stay with
+// ONEWIRE_REGISTRY_MISSING set until purge(). A search pass only ever
+// ends on one device, so rescan() still takes one pass per device on the
+// bus; to check a few suspect devices, PolledOneWire::verify() takes one
+// pass each.
+//
+// Each entry takes 9 bytes of RAM, so the table holds 16 ROMs by default
+// (144 bytes). For a bigger bus, raise ONEWIRE_REGISTRY_MAX_DEVICES, up to
+// 255, with a compiler flag such as -DONEWIRE_REGISTRY_MAX_DEVICES=64: the
+// library is compiled apart from the sketch, so a #define in the sketch
+// doesn't reach it. If a search finds more devices than fit, overflow is
+// set and the table no longer shows the whole bus.
+//
+// ROMs and saved tables are CRC checked, so this needs ONEWIRE_CRC;
+// without it there is no PolledOneWireRegistry.
+
+#ifndef ONEWIRE_REGISTRY_MAX_DEVICES
+#define ONEWIRE_REGISTRY_MAX_DEVICES 16
+#endif
+#if ONEWIRE_REGISTRY_MAX_DEVICES > 255
+#error "ONEWIRE_REGISTRY_MAX_DEVICES can be at most 255"
+#endif
+
+// EEPROM persistence is available on AVR and in the host build
+#if !defined(ONEWIRE_REGISTRY_EEPROM) && (defined(__AVR__) || defined(ONEWIRE_HOST_SIM))
+#define ONEWIRE_REGISTRY_EEPROM 1
+#endif
+
+class PolledOneWireRegistry
+{
+  public:
+	PolledOneWireRegistry();
+
+	void clear();
+
+	// Add a ROM. Returns false if its CRC is bad or the table is full;
+	// true if it was added or was already there.
+	bool add( const uint8_t rom[8] );
+	bool remove( const uint8_t rom[8] );
+
+	// Index of the ROM in the table, or -1 if it isn't there.
+	int16_t find( const uint8_t rom[8] );
+
+	// Devices of one family are at family_first(), family_first() + 1, ...
+	// up to family_count() of them.
+	uint8_t family_first( uint8_t family );
+	uint8_t family_count( uint8_t family );
+
+#if ONEWIRE_SEARCH
+	// Fill the table with a full, blocking search of the bus. Returns the
+	// number of devices in the table.
+	uint8_t scan( PolledOneWire *ow );
+	// Search the bus again and flag the changes. Returns the number of
+	// ROMs that are new or missing, plus the new ones there was no room
+	// for.
+	uint8_t rescan( PolledOneWire *ow );
+#endif
+	// Remove the missing ROMs and clear the new flags
+	void purge();
+
+#if ONEWIRE_REGISTRY_EEPROM
+	// Save the table at the given EEPROM address, only writing bytes that
+	// changed. It takes 4 + 8 * count bytes.
+	void save( int address );
+	// Load a table saved by save(). Returns false, and leaves the table
+	// empty, if there is no valid table there.
+	bool load( int address );
+#endif
+
+	uint8_t count;
+	bool overflow; // The last scan() or rescan() found devices there was no room for
+	uint8_t rom[ONEWIRE_REGISTRY_MAX_DEVICES][8]; // Sorted, don't modify
+	uint8_t flags[ONEWIRE_REGISTRY_MAX_DEVICES]; // Set by rescan()
+#define ONEWIRE_REGISTRY_NEW			0x01
+#define ONEWIRE_REGISTRY_MISSING		0x02
+
+  private:
+	uint8_t lower_bound( const uint8_t rom[8] );
+	static int8_t compare( const uint8_t *a, const uint8_t *b );
+};
+
+#endif // ONEWIRE_CRC
+
+#endif
@@ -0,0 +1,1256 @@
+/*
+Host-side simulated 1-Wire bus for PolledOneWire.  See PolledOneWireSim.h.
+
+Slave timing follows the Maxim standard and overdrive speed figures: a
+slave samples a write slot 15-60 us (standard) or 2-6 us (overdrive)
+after the falling edge, and holds the line low for 30 us (standard) or
+3 us (overdrive) when it answers a read slot with a 0.  A low pulse of
+480 us or more is a reset at either speed; 48-80 us is an overdrive
+reset.  A reset low longer than OneWireSim::reset_low_max is taken as a
+power-on reset, and gets no presence pulse.  Anything a real slave could
+misread is counted in OneWireSim::violations.
+*/
+
+#if defined(ONEWIRE_HOST_SIM)
+
+#include "PolledOneWire.h"
+
+#define SIM_MAX_DEVICES 64
+
+static volatile uint8_t simRegs[ONEWIRE_SIM_PORTS * 3];  // PIN, DDR, PORT per port
+
+struct SimLine {
+	OneWireSimDevice *devices[SIM_MAX_DEVICES];
+	uint8_t count;
+	bool masterLow;
+};
+static SimLine simLines[ONEWIRE_SIM_PORTS * 8];
+
+static bool simInterruptsOn = true;
+static bool simInTimer = false;
+static unsigned long simCriticalStart;
+
+unsigned long OneWireSim::now = 0;
+unsigned int OneWireSim::micros_cost = 1;
+unsigned long OneWireSim::violations = 0;
+unsigned long OneWireSim::max_critical = 0;
+unsigned int OneWireSim::i2c_byte_us = 90;
+unsigned int OneWireSim::reset_low_max = 960;
+void (*OneWireSim::timer_handler)(void) = 0;
+bool OneWireSim::timer_armed = false;
+unsigned long OneWireSim::timer_at = 0;
+
+static uint8_t sim_crc8(const uint8_t *p, uint16_t len, uint8_t crc = 0)
+{
+	while (len--) {
+		uint8_t inbyte = *p++;
+		for (uint8_t i = 8; i; i--) {
+			uint8_t mix = (crc ^ inbyte) & 0x01;
+			crc >>= 1;
+			if (mix) crc ^= 0x8C;
+			inbyte >>= 1;
+		}
+	}
+	return crc;
+}
+
+static uint16_t sim_crc16(const uint8_t *p, uint16_t len, uint16_t crc = 0)
+{
+	while (len--) {
+		crc ^= *p++;
+		for (uint8_t i = 8; i; i--)
+			crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : (crc >> 1);
+	}
+	return crc;
+}
+
+//
+// Arduino API
+//
+
+volatile uint8_t *onewire_sim_pin_to_basereg(uint8_t pin)
+{
+	return &simRegs[(pin / 8) * 3];
+}
+
+uint8_t onewire_sim_pin_to_bitmask(uint8_t pin)
+{
+	return 1 << (pin % 8);
+}
+
+unsigned long micros(void)
+{
+	delayMicroseconds(OneWireSim::micros_cost);
+	return OneWireSim::now;
+}
+
+unsigned long millis(void)
+{
+	return micros() / 1000;
+}
+
+void delayMicroseconds(unsigned int us)
+{
+	unsigned long end = OneWireSim::now + us;
+
+	OneWireSim::sync();
+	// Let an armed timer interrupt land at its own time, not at the
+	// end of the delay.
+	while (OneWireSim::timer_armed && simInterruptsOn && !simInTimer
+			&& OneWireSim::timer_at > OneWireSim::now && OneWireSim::timer_at < end) {
+		OneWireSim::now = OneWireSim::timer_at;
+		OneWireSim::sync();
+	}
+	OneWireSim::now = end;
+	OneWireSim::sync();
+}
+
+void delay(unsigned long ms)
+{
+	while (ms--)
+		delayMicroseconds(1000);
+}
+
+void noInterrupts(void)
+{
+	OneWireSim::sync();
+	if (simInterruptsOn) {
+		simInterruptsOn = false;
+		simCriticalStart = OneWireSim::now;
+	}
+}
+
+void interrupts(void)
+{
+	OneWireSim::sync();
+	if (!simInterruptsOn) {
+		simInterruptsOn = true;
+		if (OneWireSim::now - simCriticalStart > OneWireSim::max_critical)
+			OneWireSim::max_critical = OneWireSim::now - simCriticalStart;
+	}
+	OneWireSim::sync();
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+	volatile uint8_t *reg = onewire_sim_pin_to_basereg(pin);
+	uint8_t mask = onewire_sim_pin_to_bitmask(pin);
+
+	if (mode == OUTPUT) {
+		reg[1] |= mask;
+	} else {
+		reg[1] &= ~mask;
+		reg[2] &= ~mask;
+	}
+	OneWireSim::sync();
+}
+
+static uint8_t simEeprom[ONEWIRE_SIM_EEPROM_SIZE] = { 0 };
+static bool simEepromErased = false;
+
+static uint8_t *sim_eeprom_byte(const uint8_t *p)
+{
+	if (!simEepromErased) {
+		memset(simEeprom, 0xFF, sizeof(simEeprom));
+		simEepromErased = true;
+	}
+	return &simEeprom[(uintptr_t) p % ONEWIRE_SIM_EEPROM_SIZE];
+}
+
+uint8_t eeprom_read_byte(const uint8_t *p)
+{
+	return *sim_eeprom_byte(p);
+}
+
+void eeprom_write_byte(uint8_t *p, uint8_t value)
+{
+	*sim_eeprom_byte(p) = value;
+}
+
+#define SIM_MAX_I2C_DEVICES 8
+
+static OneWireSimI2CDevice *simI2C[SIM_MAX_I2C_DEVICES];
+static uint8_t simI2CCount = 0;
+
+static OneWireSimI2CDevice *sim_i2c_device(uint8_t address)
+{
+	for (uint8_t i = 0; i < simI2CCount; i++)
+		if (simI2C[i]->address == address)
+			return simI2C[i];
+	return 0;
+}
+
+TwoWire Wire;
+
+void TwoWire::beginTransmission(uint8_t address)
+{
+	this->address = address;
+	len = 0;
+}
+
+size_t TwoWire::write(uint8_t b)
+{
+	if (len >= sizeof(buf))
+		return 0;
+	buf[len++] = b;
+	return 1;
+}
+
+// Returns 2 if nobody acknowledged the address, as the AVR Wire does
+uint8_t TwoWire::endTransmission(bool stop)
+{
+	OneWireSimI2CDevice *dev = sim_i2c_device(address);
+
+	(void) stop;
+	delayMicroseconds(OneWireSim::i2c_byte_us * (1 + len));
+	if (!dev)
+		return 2;
+	dev->i2c_write(buf, len);
+	return 0;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity)
+{
+	OneWireSimI2CDevice *dev = sim_i2c_device(address);
+
+	delayMicroseconds(OneWireSim::i2c_byte_us * (1 + quantity));
+	len = 0;
+	pos = 0;
+	if (!dev)
+		return 0;
+	while (len < quantity && len < sizeof(buf))
+		buf[len++] = dev->i2c_read();
+	return len;
+}
+
+int TwoWire::available()
+{
+	return len - pos;
+}
+
+int TwoWire::read()
+{
+	if (pos >= len)
+		return -1;
+	return buf[pos++];
+}
+
+//
+// Bus
+//
+
+void OneWireSim::attach(uint8_t pin, OneWireSimDevice *dev)
+{
+	SimLine *line = &simLines[pin];
+	if (line->count < SIM_MAX_DEVICES)
+		line->devices[line->count++] = dev;
+	sync();
+}
+
+void OneWireSim::attach_i2c(OneWireSimI2CDevice *dev)
+{
+	if (simI2CCount < SIM_MAX_I2C_DEVICES)
+		simI2C[simI2CCount++] = dev;
+}
+
+void OneWireSim::clear()
+{
+	memset(simLines, 0, sizeof(simLines));
+	for (uint8_t i = 0; i < ONEWIRE_SIM_PORTS * 3; i++)
+		simRegs[i] = (i % 3 == 0) ? 0xFF : 0x00;
+	now = 0;
+	violations = 0;
+	max_critical = 0;
+	simI2CCount = 0;
+	timer_armed = false;
+	simInterruptsOn = true;
+}
+
+void OneWireSim::sync()
+{
+	for (uint8_t i = 0; i < ONEWIRE_SIM_PORTS * 8; i++) {
+		SimLine *line = &simLines[i];
+		volatile uint8_t *reg = &simRegs[(i / 8) * 3];
+		uint8_t mask = 1 << (i % 8);
+		bool output = reg[1] & mask;
+		bool masterLow = output && !(reg[2] & mask);
+		bool strong = output && (reg[2] & mask);
+		bool slaveLow = false;
+
+		for (uint8_t d = 0; d < line->count; d++)
+			line->devices[d]->tick(now, strong);
+		if (masterLow != line->masterLow) {
+			line->masterLow = masterLow;
+			for (uint8_t d = 0; d < line->count; d++)
+				line->devices[d]->master_edge(masterLow, now);
+		}
+		for (uint8_t d = 0; d < line->count; d++)
+			if (line->devices[d]->pulling_low(now))
+				slaveLow = true;
+		if (strong && slaveLow)
+			violations++;	// master drives high against a slave
+		if (masterLow || (slaveLow && !strong))
+			reg[0] &= ~mask;
+		else
+			reg[0] |= mask;
+	}
+
+	if (timer_armed && simInterruptsOn && !simInTimer && now >= timer_at && timer_handler) {
+		// Hardware enters an ISR with interrupts disabled.
+		timer_armed = false;
+		simInTimer = true;
+		simInterruptsOn = false;
+		simCriticalStart = now;
+		timer_handler();
+		simInterruptsOn = true;
+		simInTimer = false;
+	}
+}
+
+//
+// Slave bit level and ROM layer
+//
+
+OneWireSimDevice::OneWireSimDevice(const uint8_t r[8])
+{
+	memcpy(rom, r, 8);
+	rom[7] = sim_crc8(rom, 7);
+	present = true;
+	stuck_low = false;
+	overdrive = false;
+	supports_resume = false;
+	supports_overdrive = false;
+	mode = MODE_IDLE;
+	layer = LAYER_ROM;
+	rxByte = rxBits = 0;
+	rcFlag = false;
+	romTx = false;
+	txHead = txCount = 0;
+	holdFrom = holdUntil = 0;
+	lowStart = 0;
+	slotIsTx = false;
+	now = 0;
+}
+
+bool OneWireSimDevice::pulling_low(unsigned long t)
+{
+	return present && (stuck_low || (t >= holdFrom && t < holdUntil));
+}
+
+void OneWireSimDevice::send_bit(uint8_t v)
+{
+	if (txCount < sizeof(txBits)) {
+		txBits[(txHead + txCount) % sizeof(txBits)] = v ? 1 : 0;
+		txCount++;
+	}
+	mode = MODE_TX;
+}
+
+void OneWireSimDevice::send(uint8_t v)
+{
+	for (uint8_t i = 0; i < 8; i++)
+		send_bit((v >> i) & 1);
+}
+
+void OneWireSimDevice::send_bytes(const uint8_t *buf, uint16_t len)
+{
+	while (len--)
+		send(*buf++);
+}
+
+void OneWireSimDevice::send_crc16(uint16_t crc)
+{
+	crc = ~crc;
+	send(crc & 0xFF);
+	send(crc >> 8);
+}
+
+void OneWireSimDevice::transmit()
+{
+	mode = MODE_TX;
+	txCount = 0;
+}
+
+void OneWireSimDevice::receive()
+{
+	mode = MODE_RX;
+	txCount = 0;
+	rxBits = rxByte = 0;
+}
+
+void OneWireSimDevice::go_idle()
+{
+	mode = MODE_IDLE;
+	txCount = 0;
+}
+
+void OneWireSimDevice::master_edge(bool low, unsigned long t)
+{
+	now = t;
+	if (!present)
+		return;
+
+	if (low) {
+		lowStart = t;
+		slotIsTx = false;
+		falling_edge(t);
+		uint8_t bit = 1;
+		if (mode == MODE_TX) {
+			slotIsTx = true;
+			if (txCount) {
+				bit = txBits[txHead];
+				txHead = (txHead + 1) % sizeof(txBits);
+				txCount--;
+				if (!txCount) {
+					if (romTx) {
+						romTx = false;
+						layer = LAYER_FUNCTION;
+						receive();
+					} else {
+						tx_done();
+					}
+				}
+			} else {
+				bit = stream_bit(t);
+			}
+		} else if (mode == MODE_SEARCH && searchPhase < 2) {
+			slotIsTx = true;
+			bit = (rom[searchBit / 8] >> (searchBit % 8)) & 1;
+			if (searchPhase == 1)
+				bit = !bit;
+			searchPhase++;
+		}
+		if (slotIsTx && !bit) {
+			holdFrom = t;
+			holdUntil = t + (overdrive ? 3 : 30);
+		}
+		return;
+	}
+
+	unsigned long d = t - lowStart;
+
+	if (d >= 480 || (overdrive && d >= 48 && d < 80)) {
+		// Reset: answer with a presence pulse
+		if (d >= 480)
+			overdrive = false;
+		if (OneWireSim::reset_low_max && d > OneWireSim::reset_low_max) {
+			// Held too long: a power-on reset, and no presence pulse
+			OneWireSim::violations++;
+			rcFlag = false;
+		} else {
+			holdFrom = t + (overdrive ? 3 : 30);
+			holdUntil = holdFrom + (overdrive ? 10 : 120);
+		}
+		layer = LAYER_ROM;
+		romTx = false;
+		receive();
+		bus_reset();
+		return;
+	}
+	if (overdrive ? (d > 16) : (d > 120)) {
+		OneWireSim::violations++;	// neither a slot nor a reset
+		go_idle();
+		return;
+	}
+	if (slotIsTx) {
+		if (d > (overdrive ? 2u : 15u))
+			OneWireSim::violations++;	// read slot held low into the sample window
+		return;
+	}
+	if (mode != MODE_RX && !(mode == MODE_SEARCH && searchPhase == 2))
+		return;
+
+	uint8_t v;
+	if (overdrive) {
+		if (d < 2) v = 1;
+		else if (d >= 6) v = 0;
+		else { v = 0; OneWireSim::violations++; }
+	} else {
+		if (d < 15) v = 1;
+		else if (d >= 60) v = 0;
+		else { v = d < 30; OneWireSim::violations++; }
+	}
+
+	if (mode == MODE_SEARCH) {
+		uint8_t mine = (rom[searchBit / 8] >> (searchBit % 8)) & 1;
+		if (v != mine) {
+			go_idle();
+			return;
+		}
+		searchPhase = 0;
+		if (++searchBit == 64) {
+			rcFlag = true;
+			layer = LAYER_FUNCTION;
+			receive();
+		}
+		return;
+	}
+	rx_bit(v);
+}
+
+void OneWireSimDevice::rx_bit(uint8_t v)
+{
+	rxByte |= v << rxBits;
+	if (++rxBits < 8)
+		return;
+	uint8_t b = rxByte;
+	rxByte = rxBits = 0;
+
+	if (layer == LAYER_ROM) {
+		rom_byte(b);
+	} else if (layer == LAYER_MATCH) {
+		if (b != rom[matchIndex])
+			matchOk = false;
+		if (++matchIndex == 8) {
+			if (matchOk) {
+				rcFlag = true;
+				layer = LAYER_FUNCTION;
+			} else {
+				rcFlag = false;
+				if (matchOverdrive)
+					overdrive = false;
+				go_idle();
+			}
+		}
+	} else {
+		function_byte(b);
+	}
+}
+
+void OneWireSimDevice::rom_byte(uint8_t b)
+{
+	switch (b) {
+	case 0x33:	// Read ROM
+		romTx = true;
+		send_bytes(rom, 8);
+		break;
+	case 0x69:	// Overdrive Match ROM
+		if (!supports_overdrive) {
+			go_idle();
+			break;
+		}
+		overdrive = true;
+		// fall through
+	case 0x55:	// Match ROM
+		matchOverdrive = (b == 0x69);
+		layer = LAYER_MATCH;
+		matchIndex = 0;
+		matchOk = true;
+		break;
+	case 0x3C:	// Overdrive Skip ROM
+		if (!supports_overdrive) {
+			go_idle();
+			break;
+		}
+		overdrive = true;
+		// fall through
+	case 0xCC:	// Skip ROM
+		rcFlag = false;
+		layer = LAYER_FUNCTION;
+		break;
+	case 0xEC:	// Alarm Search
+	case 0xF0:	// Search ROM
+		rcFlag = false;
+		if (b == 0xEC && !alarm()) {
+			go_idle();
+			break;
+		}
+		mode = MODE_SEARCH;
+		searchBit = 0;
+		searchPhase = 0;
+		break;
+	case 0xA5:	// Resume
+		if (supports_resume && rcFlag)
+			layer = LAYER_FUNCTION;
+		else
+			go_idle();
+		break;
+	default:
+		go_idle();
+		break;
+	}
+}
+
+//
+// DS18x20
+//
+
+OneWireSimDS18x20::OneWireSimDS18x20(const uint8_t r[8], bool p)
+	: OneWireSimDevice(r)
+{
+	parasite = p;
+	temperature = 25 * 16;
+	conversions = 0;
+	conversion_failed = false;
+	converting = false;
+	command = index = 0;
+	conversion_us = 0;
+	memset(scratchpad, 0xFF, sizeof(scratchpad));
+	if (rom[0] == 0x10) {
+		scratchpad[0] = 0xAA;	// 85 C power-on value
+		scratchpad[1] = 0x00;
+		scratchpad[6] = 0x0C;
+		scratchpad[7] = 0x10;
+	} else {
+		scratchpad[0] = 0x50;
+		scratchpad[1] = 0x05;
+		scratchpad[4] = 0x7F;	// 12 bit
+		scratchpad[6] = 0x0C;
+		scratchpad[7] = 0x10;
+	}
+	scratchpad[2] = 0x4B;
+	scratchpad[3] = 0x46;
+	update_crc();
+}
+
+void OneWireSimDS18x20::update_crc()
+{
+	scratchpad[8] = sim_crc8(scratchpad, 8);
+}
+
+unsigned long OneWireSimDS18x20::conversion_time()
+{
+	if (conversion_us)
+		return conversion_us;
+	if (rom[0] == 0x10)
+		return 750000;
+	switch (scratchpad[4] & 0x60) {
+	case 0x00: return 93750;
+	case 0x20: return 187500;
+	case 0x40: return 375000;
+	}
+	return 750000;
+}
+
+bool OneWireSimDS18x20::alarm()
+{
+	int8_t deg = (int8_t) (temperature >> 4);
+	return deg >= (int8_t) scratchpad[2] || deg <= (int8_t) scratchpad[3];
+}
+
+void OneWireSimDS18x20::tick(unsigned long t, bool strongPullup)
+{
+	if (!converting)
+		return;
+	if (t >= convEnd) {
+		converting = false;
+		if (conversion_failed)
+			return;
+		conversions++;
+		if (rom[0] == 0x10) {
+			// Read back as TEMP_READ - 0.25 + (16 - COUNT_REMAIN) / 16,
+			// with the half degree bit of TEMP_READ dropped
+			int16_t v = temperature + 4;
+			int16_t half = v >> 3;	// Rounded to the nearest half degree
+			scratchpad[0] = half & 0xFF;
+			scratchpad[1] = (half >> 8) & 0xFF;
+			scratchpad[6] = 16 - (v & 0x0F);	// count remain, 0x10 per degree
+		} else {
+			int16_t v = temperature;
+			switch (scratchpad[4] & 0x60) {
+			case 0x00: v &= ~7; break;
+			case 0x20: v &= ~3; break;
+			case 0x40: v &= ~1; break;
+			}
+			scratchpad[0] = v & 0xFF;
+			scratchpad[1] = (v >> 8) & 0xFF;
+		}
+		update_crc();
+		return;
+	}
+	if (parasite && !strongPullup)
+		conversion_failed = true;
+}
+
+uint8_t OneWireSimDS18x20::stream_bit(unsigned long t)
+{
+	if (command == 0x44)
+		return (converting && t < convEnd) ? 0 : 1;
+	return 1;
+}
+
+void OneWireSimDS18x20::function_byte(uint8_t b)
+{
+	if (index == 0) {
+		command = b;
+		index = 1;
+		switch (b) {
+		case 0x44:	// Convert T
+			converting = true;
+			conversion_failed = false;
+			convEnd = now + conversion_time();
+			transmit();	// read slots report busy until done
+			break;
+		case 0xBE:	// Read Scratchpad
+			send_bytes(scratchpad, 9);
+			break;
+		case 0xB4:	// Read Power Supply
+			send_bit(parasite ? 0 : 1);
+			break;
+		case 0x4E:	// Write Scratchpad
+			break;
+		default:
+			go_idle();
+			break;
+		}
+		return;
+	}
+	if (command == 0x4E) {
+		if (index <= 3)
+			scratchpad[index + 1] = b;
+		if (rom[0] == 0x10 && index == 2)
+			index = 3;
+		index++;
+		update_crc();
+	}
+}
+
+void OneWireSimDS18x20::bus_reset()
+{
+	index = 0;
+	command = 0;
+}
+
+//
+// DS2408
+//
+
+OneWireSimDS2408::OneWireSimDS2408(const uint8_t r[8])
+	: OneWireSimDevice(r)
+{
+	supports_resume = true;
+	supports_overdrive = true;
+	pio_input = 0xFF;
+	memset(regs, 0xFF, sizeof(regs));
+	regs[2] = 0x00;
+	regs[3] = 0x00;
+	regs[4] = 0x00;
+	regs[5] = 0x88;
+	samples = 0;
+	command = index = 0;
+}
+
+uint8_t OneWireSimDS2408::pio_state()
+{
+	samples++;
+	return pio_input & regs[1];
+}
+
+void OneWireSimDS2408::stream_block()
+{
+	uint8_t block[32];
+	for (uint8_t i = 0; i < 32; i++)
+		block[i] = pio_state();
+	crc = sim_crc16(block, 32, crc);
+	send_bytes(block, 32);
+	send_crc16(crc);
+	crc = 0;
+}
+
+void OneWireSimDS2408::function_byte(uint8_t b)
+{
+	if (index == 0) {
+		command = b;
+		index = 1;
+		crc = sim_crc16(&b, 1);
+		switch (b) {
+		case 0xF5:	// Channel-Access Read
+			stream_block();
+			break;
+		case 0xF0:	// Read PIO Registers
+		case 0x5A:	// Channel-Access Write
+		case 0xCC:	// Write Conditional Search Register
+			break;
+		case 0xC3:	// Reset Activity Latches
+			regs[2] = 0;
+			send(0xAA);
+			break;
+		default:
+			go_idle();
+			break;
+		}
+		return;
+	}
+	switch (command) {
+	case 0xF0:
+		crc = sim_crc16(&b, 1, crc);
+		if (index == 1) {
+			addr = b;
+		} else {
+			addr |= b << 8;
+			regs[0] = pio_state();
+			uint8_t data[8];
+			uint8_t n = 0;
+			for (uint16_t a = addr; a >= 0x88 && a <= 0x8F; a++)
+				data[n++] = regs[a - 0x88];
+			crc = sim_crc16(data, n, crc);
+			send_bytes(data, n);
+			send_crc16(crc);
+		}
+		index++;
+		break;
+	case 0x5A:
+		if (index == 1) {
+			writeByte = b;
+			index = 2;
+		} else {
+			if ((uint8_t) ~b != writeByte) {
+				go_idle();
+				break;
+			}
+			regs[1] = writeByte;
+			send(0xAA);
+			send(pio_state());
+			index = 1;
+		}
+		break;
+	case 0xCC:
+		if (index == 1) {
+			addr = b;
+		} else if (index == 2) {
+			addr |= b << 8;
+		} else if (addr >= 0x8B && addr <= 0x8D) {
+			regs[addr - 0x88] = b;
+			addr++;
+		}
+		index++;
+		break;
+	}
+}
+
+void OneWireSimDS2408::tx_done()
+{
+	if (command == 0xF5)
+		stream_block();
+	else if (command == 0x5A)
+		receive();
+}
+
+void OneWireSimDS2408::bus_reset()
+{
+	index = 0;
+	command = 0;
+}
+
+//
+// DS2502
+//
+
+OneWireSimDS2502::OneWireSimDS2502(const uint8_t r[8])
+	: OneWireSimDevice(r)
+{
+	for (uint8_t i = 0; i < sizeof(memory); i++)
+		memory[i] = i;
+	command = index = 0;
+}
+
+void OneWireSimDS2502::function_byte(uint8_t b)
+{
+	if (index == 0) {
+		command = b;
+		index = 1;
+		if (b != 0xF0 && b != 0xC3)
+			go_idle();
+		return;
+	}
+	if (index == 1) {
+		addr = b;
+		index++;
+		return;
+	}
+	if (index == 2) {
+		addr |= b << 8;
+		index++;
+		uint8_t cmd[3] = { command, (uint8_t) (addr & 0xFF), (uint8_t) (addr >> 8) };
+		send(sim_crc8(cmd, 3));
+		crc = 0;
+		if (addr >= sizeof(memory)) {
+			go_idle();
+			return;
+		}
+		if (command == 0xF0) {
+			crc = sim_crc8(memory + addr, sizeof(memory) - addr);
+			send_bytes(memory + addr, sizeof(memory) - addr);
+			send(crc);
+		} else {
+			uint16_t end = (addr | 31) + 1;
+			crc = sim_crc8(memory + addr, end - addr);
+			send_bytes(memory + addr, end - addr);
+			send(crc);
+			addr = end;
+		}
+	}
+}
+
+void OneWireSimDS2502::tx_done()
+{
+	// Read Data/Generate 8-bit CRC continues with the next page
+	if (command == 0xC3 && index == 3 && addr < sizeof(memory)) {
+		send_bytes(memory + addr, 32);
+		send(sim_crc8(memory + addr, 32));
+		addr += 32;
+	}
+}
+
+void OneWireSimDS2502::bus_reset()
+{
+	index = 0;
+	command = 0;
+}
+
+//
+// Scratchpad EEPROMs
+//
+
+OneWireSimEEPROM::OneWireSimEEPROM(const uint8_t r[8], uint8_t *memory, uint16_t memory_size,
+	uint8_t *scratch, uint8_t scratch_size)
+	: OneWireSimDevice(r)
+{
+	supports_resume = true;
+	supports_overdrive = true;
+	extended_read = false;
+	mem = memory;
+	memSize = memory_size;
+	this->scratch = scratch;
+	scratchSize = scratch_size;
+	memset(scratch, 0xFF, scratch_size);
+	copies = 0;
+	copy_failed = false;
+	programming = false;
+	command = index = 0;
+	ta = 0;
+	es = 0;
+}
+
+void OneWireSimEEPROM::falling_edge(unsigned long t)
+{
+	if (programming && t < progEnd)
+		copy_failed = true;
+}
+
+void OneWireSimEEPROM::tick(unsigned long t, bool /* strongPullup */)
+{
+	if (programming && t >= progEnd) {
+		programming = false;
+		if (!copy_failed) {
+			memcpy(mem + (ta & ~(scratchSize - 1)), scratch, scratchSize);
+			copies++;
+			es |= 0x80;
+		}
+	}
+}
+
+uint8_t OneWireSimEEPROM::stream_bit(unsigned long t)
+{
+	if (command == 0x55 && index == 4) {
+		if (programming && t < progEnd)
+			return 1;
+		return (aaPhase++) & 1;	// 0xAA, LSB first
+	}
+	return 1;
+}
+
+//
+// Send from ta to the end of its page. Extended Read Memory follows it
+// with the CRC16, which covers the command and address too on the first
+// page.
+//
+void OneWireSimEEPROM::send_page()
+{
+	uint16_t end = (ta | 31) + 1;
+
+	if (end > memSize)
+		end = memSize;
+	send_bytes(mem + ta, end - ta);
+	if (command == 0xA5) {
+		crc = sim_crc16(mem + ta, end - ta, crc);
+		send_crc16(crc);
+		crc = 0;
+	}
+	ta = end;
+}
+
+void OneWireSimEEPROM::function_byte(uint8_t b)
+{
+	if (index == 0) {
+		command = b;
+		index = 1;
+		crc = sim_crc16(&b, 1);
+		switch (b) {
+		case 0xAA: {	// Read Scratchpad
+			uint8_t hdr[3] = { (uint8_t) (ta & 0xFF), (uint8_t) (ta >> 8), es };
+			uint8_t from = ta & (scratchSize - 1), to = es & (scratchSize - 1);
+			crc = sim_crc16(hdr, 3, crc);
+			send_bytes(hdr, 3);
+			if (to >= from) {
+				crc = sim_crc16(scratch + from, to - from + 1, crc);
+				send_bytes(scratch + from, to - from + 1);
+			}
+			send_crc16(crc);
+			break;
+		}
+		case 0xA5:	// Extended Read Memory
+			if (!extended_read)
+				go_idle();
+			break;
+		case 0x0F:	// Write Scratchpad
+		case 0x55:	// Copy Scratchpad
+		case 0xF0:	// Read Memory
+			break;
+		default:
+			go_idle();
+			break;
+		}
+		return;
+	}
+	switch (command) {
+	case 0x0F:
+		crc = sim_crc16(&b, 1, crc);
+		if (index == 1) {
+			ta = b;
+		} else if (index == 2) {
+			ta |= b << 8;
+			es = ta & (scratchSize - 1);
+		} else {
+			uint8_t off = (ta & (scratchSize - 1)) + (index - 3);
+			if (off < scratchSize) {
+				scratch[off] = b;
+				es = off;
+				if (off == scratchSize - 1)
+					send_crc16(crc);
+			}
+		}
+		index++;
+		break;
+	case 0x55:
+		if (index == 1) {
+			copyTa = b;
+		} else if (index == 2) {
+			copyTa |= b << 8;
+		} else if (index == 3) {
+			if (copyTa != ta || b != es || ta >= memSize) {
+				go_idle();
+				break;
+			}
+			programming = true;
+			copy_failed = false;
+			progEnd = now + 10000;	// tPROG
+			aaPhase = 0;
+			transmit();	// read slots report progress
+		}
+		index++;
+		break;
+	case 0xF0:
+	case 0xA5:
+		crc = sim_crc16(&b, 1, crc);
+		if (index == 1) {
+			ta = b;
+		} else if (index == 2) {
+			ta |= b << 8;
+			if (ta >= memSize) {
+				go_idle();
+				return;
+			}
+			send_page();
+		}
+		index++;
+		break;
+	}
+}
+
+void OneWireSimEEPROM::tx_done()
+{
+	// Memory reads go on to the next page, up to the end of memory
+	if ((command == 0xF0 || command == 0xA5) && index == 3 && ta < memSize)
+		send_page();
+}
+
+void OneWireSimEEPROM::bus_reset()
+{
+	index = 0;
+	command = 0;
+}
+
+OneWireSimDS2431::OneWireSimDS2431(const uint8_t r[8])
+	: OneWireSimEEPROM(r, memory, sizeof(memory), scratchpad, sizeof(scratchpad))
+{
+	memset(memory, 0xFF, sizeof(memory));
+}
+
+OneWireSimDS28EC20::OneWireSimDS28EC20(const uint8_t r[8])
+	: OneWireSimEEPROM(r, memory, sizeof(memory), scratchpad, sizeof(scratchpad))
+{
+	extended_read = true;
+	for (uint16_t i = 0; i < sizeof(memory); i++)
+		memory[i] = i ^ (i >> 8);
+}
+
+// DS2482 registers, as selected by the read pointer
+#define DS2482_REG_STATUS	0xF0
+#define DS2482_REG_DATA		0xE1
+#define DS2482_REG_CHANNEL	0xD2
+#define DS2482_REG_CONFIG	0xC3
+
+// Status and configuration bits
+#define DS2482_STATUS_1WB	0x01
+#define DS2482_STATUS_PPD	0x02
+#define DS2482_STATUS_RST	0x10
+#define DS2482_STATUS_SBR	0x20
+#define DS2482_STATUS_TSB	0x40
+#define DS2482_STATUS_DIR	0x80
+#define DS2482_CONFIG_SPU	0x04
+#define DS2482_CONFIG_1WS	0x08
+
+// Channel select codes, and what the channel register reads back
+static const uint8_t ds2482ChannelCode[8] = { 0xF0, 0xE1, 0xD2, 0xC3, 0xB4, 0xA5, 0x96, 0x87 };
+static const uint8_t ds2482ChannelRead[8] = { 0xB8, 0xB1, 0xAA, 0xA3, 0x9C, 0x95, 0x8E, 0x87 };
+
+OneWireSimDS2482::OneWireSimDS2482(uint8_t address, const uint8_t *pins, uint8_t channels)
+	: OneWireSimI2CDevice(address)
+{
+	if (channels > 8)
+		channels = 8;
+	this->channels = channels;
+	for (uint8_t i = 0; i < channels; i++)
+		ow[i] = new PolledOneWire(pins[i]);
+	busy_reads = 0;
+	commands = 0;
+	channel = 0;
+	status = DS2482_STATUS_RST;
+	config = 0;
+	data = 0;
+	readPtr = DS2482_REG_STATUS;
+	busy = 0;
+	strongPullup = false;
+}
+
+OneWireSimDS2482::~OneWireSimDS2482()
+{
+	for (uint8_t i = 0; i < channels; i++)
+		delete ow[i];
+}
+
+void OneWireSimDS2482::i2c_write(const uint8_t *buf, uint8_t len)
+{
+	if (len < 1)
+		return;
+	switch (buf[0]) {
+	case 0xF0:	// Device Reset
+		if (strongPullup)
+			ow[channel]->depower();
+		strongPullup = false;
+		status = DS2482_STATUS_RST;
+		config = 0;
+		channel = 0;
+		busy = 0;
+		readPtr = DS2482_REG_STATUS;
+		break;
+	case 0xE1:	// Set Read Pointer
+		if (len >= 2)
+			readPtr = buf[1];
+		break;
+	case 0xD2:	// Write Configuration, upper nibble is the complement
+		if (len >= 2 && (buf[1] >> 4) == (~buf[1] & 0x0F)) {
+			if (strongPullup && !(buf[1] & DS2482_CONFIG_SPU)) {
+				ow[channel]->depower();
+				strongPullup = false;
+			}
+			config = buf[1] & 0x0F;
+			status &= ~DS2482_STATUS_RST;
+			readPtr = DS2482_REG_CONFIG;
+		}
+		break;
+	case 0xC3:	// Channel Select, DS2482-800 only
+		if (len >= 2 && channels > 1) {
+			for (uint8_t i = 0; i < channels; i++)
+				if (ds2482ChannelCode[i] == buf[1])
+					channel = i;
+			readPtr = DS2482_REG_CHANNEL;
+		}
+		break;
+	case 0xB4:	// 1-Wire Reset
+	case 0x96:	// 1-Wire Read Byte
+		one_wire(buf[0], 0);
+		break;
+	case 0xA5:	// 1-Wire Write Byte
+	case 0x87:	// 1-Wire Single Bit
+	case 0x78:	// 1-Wire Triplet
+		if (len >= 2)
+			one_wire(buf[0], buf[1]);
+		break;
+	}
+}
+
+void OneWireSimDS2482::one_wire(uint8_t command, uint8_t arg)
+{
+	PolledOneWire *line = ow[channel];
+	unsigned long critical = OneWireSim::max_critical;
+	uint8_t id, cmp, dir;
+
+	// Any 1-Wire activity ends a strong pullup
+	if (strongPullup) {
+		line->depower();
+		strongPullup = false;
+		config &= ~DS2482_CONFIG_SPU;
+	}
+	line->overdrive = (config & DS2482_CONFIG_1WS) != 0;
+	status &= ~(DS2482_STATUS_PPD | DS2482_STATUS_SBR | DS2482_STATUS_TSB | DS2482_STATUS_DIR);
+	switch (command) {
+	case 0xB4:
+		if (line->reset())
+			status |= DS2482_STATUS_PPD;
+		status &= ~DS2482_STATUS_RST;
+		break;
+	case 0x96:
+		data = line->read();
+		break;
+	case 0xA5:
+		strongPullup = (config & DS2482_CONFIG_SPU) != 0;
+		line->write(arg, strongPullup);
+		break;
+	case 0x87:
+		if (arg & 0x80) {
+			if (line->read_bit())	// a write 1 slot is a read slot
+				status |= DS2482_STATUS_SBR;
+		} else {
+			line->write_bit(0);
+		}
+		break;
+	case 0x78:
+		id = line->read_bit();
+		cmp = line->read_bit();
+		if (id != cmp)
+			dir = id;
+		else
+			dir = id ? 1 : (arg >> 7);
+		line->write_bit(dir);
+		status |= (id ? DS2482_STATUS_SBR : 0) | (cmp ? DS2482_STATUS_TSB : 0)
+			| (dir ? DS2482_STATUS_DIR : 0);
+		break;
+	}
+	OneWireSim::max_critical = critical;
+	readPtr = DS2482_REG_STATUS;
+	busy = busy_reads;
+	commands++;
+}
+
+uint8_t OneWireSimDS2482::i2c_read()
+{
+	switch (readPtr) {
+	case DS2482_REG_STATUS:
+		if (busy) {
+			busy--;
+			return status | DS2482_STATUS_1WB;
+		}
+		return status;
+	case DS2482_REG_DATA:
+		return data;
+	case DS2482_REG_CONFIG:
+		return config;
+	case DS2482_REG_CHANNEL:
+		return channels > 1 ? ds2482ChannelRead[channel] : 0;
+	}
+	return 0xFF;
+}
+
+#endif
@@ -0,0 +1,333 @@
+#ifndef PolledOneWireSim_h
+#define PolledOneWireSim_h
+
+// Host-side (Linux) backend for PolledOneWire.  Build the library with
+// -DONEWIRE_HOST_SIM and this file stands in for Arduino.h: the time
+// source is a virtual microsecond clock, and the pin registers are a
+// small simulated register file with the same PIN/DDR/PORT layout as
+// AVR, so PolledOneWire's DIRECT_* macros run unchanged.  Every 1-Wire
+// line in that register file is a simulated bus, with scripted slave
+// models attached to it by OneWireSim::attach().
+//
+// Virtual time only moves inside micros(), millis(), delay() and
+// delayMicroseconds(), and the bus is sampled at those points and at
+// noInterrupts()/interrupts(), which is exactly where the library's
+// slot timing is defined.  Each micros() call costs
+// OneWireSim::micros_cost virtual microseconds so that a caller
+// spinning on poll() makes progress.
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Arduino API subset used by the library and its examples
+
+#define PROGMEM
+#define pgm_read_byte(addr)   (*(const uint8_t *)(addr))
+#define pgm_read_word(addr)   (*(const uint16_t *)(addr))
+
+#define INPUT  0x0
+#define OUTPUT 0x1
+#define LOW    0x0
+#define HIGH   0x1
+
+#ifndef min
+#define min(a,b) ((a)<(b)?(a):(b))
+#endif
+#ifndef max
+#define max(a,b) ((a)>(b)?(a):(b))
+#endif
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+unsigned long micros(void);
+unsigned long millis(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void noInterrupts(void);
+void interrupts(void);
+void pinMode(uint8_t pin, uint8_t mode);
+
+// Simulated register file.  Pin N lives on port N/8, bit N%8.
+#define ONEWIRE_SIM_PORTS 4
+
+volatile uint8_t *onewire_sim_pin_to_basereg(uint8_t pin);
+uint8_t onewire_sim_pin_to_bitmask(uint8_t pin);
+
+// Simulated EEPROM, with the avr-libc byte access functions.  Erased
+// bytes read as 0xFF.
+#define ONEWIRE_SIM_EEPROM_SIZE 1024
+
+uint8_t eeprom_read_byte(const uint8_t *p);
+void eeprom_write_byte(uint8_t *p, uint8_t value);
+
+// Arduino Wire (I2C master) subset.  Transfers go to the simulated I2C
+// devices attached with OneWireSim::attach_i2c(), and cost
+// OneWireSim::i2c_byte_us of virtual time per byte on the wire,
+// including the address byte.
+class TwoWire
+{
+  public:
+    void begin() {}
+    void setClock(uint32_t) {}
+    void beginTransmission(uint8_t address);
+    size_t write(uint8_t b);
+    uint8_t endTransmission(bool stop = true);
+    uint8_t requestFrom(uint8_t address, uint8_t quantity);
+    int available();
+    int read();
+  private:
+    uint8_t address;
+    uint8_t buf[32];
+    uint8_t len, pos;
+};
+extern TwoWire Wire;
+
+
+// A slave on a simulated line.  The base class implements the bit
+// level (reset/presence, read and write slots at standard and
+// overdrive speed) and the ROM function layer (Read ROM, Match ROM,
+// Skip ROM, Search ROM, Alarm Search, Resume, Overdrive Skip and
+// Overdrive Match).  Subclasses implement the device function layer
+// in function_byte(), answering with send()/send_bytes().
+class OneWireSimDevice
+{
+  public:
+    OneWireSimDevice(const uint8_t rom[8]);
+    virtual ~OneWireSimDevice() {}
+
+    uint8_t rom[8];
+    bool present;          // false unplugs the device from the line
+    bool stuck_low;        // holds the line low, like a short to ground
+    bool overdrive;        // current speed of this device
+    bool supports_resume;  // answers Resume (0xA5)
+    bool supports_overdrive;
+
+    // Called by the bus.
+    void master_edge(bool low, unsigned long t);
+    bool pulling_low(unsigned long t);
+    virtual void tick(unsigned long /* t */, bool /* strongPullup */) {}
+
+  protected:
+    // Function layer hooks
+    virtual void function_byte(uint8_t /* b */) {}
+    virtual uint8_t stream_bit(unsigned long /* t */) { return 1; }
+    virtual void tx_done() {}
+    virtual bool alarm() { return false; }
+    virtual void bus_reset() {}
+    virtual void falling_edge(unsigned long /* t */) {}
+
+    void send_bit(uint8_t v);
+    void send(uint8_t v);
+    void send_bytes(const uint8_t *buf, uint16_t len);
+    void send_crc16(uint16_t crc);
+    void transmit();  // answer read slots from stream_bit()
+    void receive();   // go back to receiving bytes
+    void go_idle();   // ignore the bus until the next reset
+
+    unsigned long now;
+
+  private:
+    enum { MODE_IDLE, MODE_RX, MODE_TX, MODE_SEARCH };
+    enum { LAYER_ROM, LAYER_MATCH, LAYER_FUNCTION };
+    uint8_t mode;
+    uint8_t layer;
+    uint8_t rxByte, rxBits;
+    uint8_t matchIndex;
+    bool matchOk;
+    bool rcFlag;
+    bool searchAlarm;
+    uint8_t searchBit, searchPhase;
+    bool slotIsTx;
+    unsigned long lowStart;
+    unsigned long holdFrom, holdUntil;
+    bool matchOverdrive;
+    bool romTx;
+    uint8_t txBits[1280];      // one bit per entry
+    uint16_t txHead, txCount;
+
+    void rom_byte(uint8_t b);
+    void rx_bit(uint8_t v);
+};
+
+// DS18S20 (0x10), DS18B20 (0x28), DS1822 (0x22) temperature sensor
+class OneWireSimDS18x20 : public OneWireSimDevice
+{
+  public:
+    OneWireSimDS18x20(const uint8_t rom[8], bool parasite = false);
+    int16_t temperature;    // 1/16 degree C, what the next conversion measures
+    bool parasite;
+    uint8_t scratchpad[9];
+    unsigned long conversions;
+    unsigned long conversion_us; // 0 = datasheet maximum for the resolution
+    bool conversion_failed; // parasite conversion without strong pullup
+    void tick(unsigned long t, bool strongPullup);
+  protected:
+    void function_byte(uint8_t b);
+    uint8_t stream_bit(unsigned long t);
+    bool alarm();
+    void bus_reset();
+  private:
+    uint8_t command, index;
+    bool converting;
+    unsigned long convEnd;
+    void update_crc();
+    unsigned long conversion_time();
+};
+
+// DS2408 8-channel addressable switch (0x29)
+class OneWireSimDS2408 : public OneWireSimDevice
+{
+  public:
+    OneWireSimDS2408(const uint8_t rom[8]);
+    uint8_t pio_input;      // what the outside world drives onto the pins
+    uint8_t regs[8];        // 0x88..0x8F
+    unsigned long samples;
+  protected:
+    void function_byte(uint8_t b);
+    void tx_done();
+    void bus_reset();
+  private:
+    uint8_t command, index;
+    uint16_t addr, crc;
+    uint8_t writeByte;
+    uint8_t pio_state();
+    void stream_block();
+};
+
+// DS2502 (0x09) add-only memory, 128 bytes
+class OneWireSimDS2502 : public OneWireSimDevice
+{
+  public:
+    OneWireSimDS2502(const uint8_t rom[8]);
+    uint8_t memory[128];
+  protected:
+    void function_byte(uint8_t b);
+    void tx_done();
+    void bus_reset();
+  private:
+    uint8_t command, index;
+    uint16_t addr;
+    uint8_t crc;
+};
+
+// EEPROM with a scratchpad: Write Scratchpad (0x0F), Read Scratchpad
+// (0xAA), Copy Scratchpad (0x55) with a 10 ms tPROG, and Read Memory
+// (0xF0), plus Extended Read Memory (0xA5) if extended_read.  Any
+// falling edge on the line during tPROG spoils the copy.
+class OneWireSimEEPROM : public OneWireSimDevice
+{
+  public:
+    unsigned long copies;
+    bool copy_failed;       // bus activity during tPROG
+    void tick(unsigned long t, bool strongPullup);
+  protected:
+    OneWireSimEEPROM(const uint8_t rom[8], uint8_t *memory, uint16_t memory_size,
+        uint8_t *scratch, uint8_t scratch_size);
+    bool extended_read;
+    void function_byte(uint8_t b);
+    void tx_done();
+    uint8_t stream_bit(unsigned long t);
+    void bus_reset();
+    void falling_edge(unsigned long t);
+  private:
+    uint8_t *mem, *scratch;
+    uint16_t memSize;
+    uint8_t scratchSize;
+    uint8_t command, index;
+    uint16_t ta, copyTa;
+    uint8_t aaPhase;
+    uint8_t es;
+    uint16_t crc;
+    bool programming;
+    unsigned long progEnd;
+    void send_page();
+};
+
+// DS2431 (0x2D) 1024-bit EEPROM, 8-byte scratchpad
+class OneWireSimDS2431 : public OneWireSimEEPROM
+{
+  public:
+    OneWireSimDS2431(const uint8_t rom[8]);
+    uint8_t memory[144];
+  private:
+    uint8_t scratchpad[8];
+};
+
+// DS28EC20 (0x43) 20-kbit EEPROM, 32-byte scratchpad
+class OneWireSimDS28EC20 : public OneWireSimEEPROM
+{
+  public:
+    OneWireSimDS28EC20(const uint8_t rom[8]);
+    uint8_t memory[2560];
+  private:
+    uint8_t scratchpad[32];
+};
+
+class PolledOneWire;
+
+// A simulated I2C device
+class OneWireSimI2CDevice
+{
+  public:
+    OneWireSimI2CDevice(uint8_t address) : address(address) {}
+    virtual ~OneWireSimI2CDevice() {}
+    uint8_t address;
+    virtual void i2c_write(const uint8_t *buf, uint8_t len) = 0;
+    virtual uint8_t i2c_read() = 0;
+};
+
+// DS2482-100 (channels = 1) or DS2482-800 (channels = 8) I2C to 1-Wire
+// bridge, with channel n on the line of pins[n].  The 1-Wire part of
+// each command is done while the I2C write that issued it goes on, as a
+// blocking PolledOneWire operation, so the bridge is never found busy
+// unless busy_reads is set: then that many status reads after each
+// 1-Wire command still show 1WB.  Its slots are the bridge's own, so they
+// don't count towards OneWireSim::max_critical.
+class OneWireSimDS2482 : public OneWireSimI2CDevice
+{
+  public:
+    OneWireSimDS2482(uint8_t address, const uint8_t *pins, uint8_t channels = 1);
+    ~OneWireSimDS2482();
+    unsigned int busy_reads;
+    unsigned long commands;     // 1-Wire commands done
+    void i2c_write(const uint8_t *buf, uint8_t len);
+    uint8_t i2c_read();
+  private:
+    PolledOneWire *ow[8];
+    uint8_t channels, channel;
+    uint8_t status, config, data, readPtr;
+    unsigned int busy;
+    bool strongPullup;
+    void one_wire(uint8_t command, uint8_t arg);
+};
+
+class OneWireSim
+{
+  public:
+    // Attach a device to the line on 'pin'.  Up to 64 per line.
+    static void attach(uint8_t pin, OneWireSimDevice *dev);
+    // Put a device on the I2C bus.  Up to 8.
+    static void attach_i2c(OneWireSimI2CDevice *dev);
+    // Remove all devices, zero the clock and the counters.
+    static void clear();
+
+    static unsigned long now;          // virtual time, us
+    static unsigned int micros_cost;   // cost of each micros() call
+    static unsigned long violations;   // slot timing violations seen by slaves
+    static unsigned long max_critical; // longest interrupts-disabled window, us
+    static unsigned int i2c_byte_us;   // I2C time per byte, 90 us = 100 kHz
+    static unsigned int reset_low_max; // longest reset low, 960 us; 0 = no limit
+
+    // Host stand-in for a hardware timer compare interrupt.  When
+    // armed, 'handler' runs from the clock once virtual time reaches
+    // 'at', provided interrupts are enabled.
+    static void (*timer_handler)(void);
+    static bool timer_armed;
+    static unsigned long timer_at;
+
+    static void sync();
+};
+
+#endif
@@ -0,0 +1,54 @@
+#include <PolledOneWire.h>
+#include <PolledDS18x20.h>
+
+// Continuous, non-blocking temperature acquisition from all DS18S20,
+// DS18B20 and DS1822 sensors on a bus, parasite powered or not.
+//
+// loop() never waits for a conversion: it polls the scheduler and does
+// its own work in between.
+
+PolledOneWire  ds(10);  // on pin 10
+PolledDS18x20  sensors(&ds);
+unsigned long lastCycle;
+
+void setup(void) {
+  byte addr[8];
+
+  Serial.begin(9600);
+  while (ds.search(addr)) {
+    if (PolledOneWire::crc8(addr, 7) != addr[7])
+      continue;
+    if (sensors.add(addr))
+      Serial.println("Found a sensor");
+  }
+  ds.reset_search();
+
+  sensors.continuous = true;
+  sensors.start(ONEWIRE_DS18X20_ALL);  // or ONEWIRE_DS18X20_EACH for weak parasite supplies
+  lastCycle = sensors.cycles;
+}
+
+void loop(void) {
+  if (sensors.status)
+    sensors.poll();
+
+  if (sensors.cycles != lastCycle) {
+    // A cycle finished while we were busy elsewhere. The next one is
+    // already running, and its results will land in the same place only
+    // once each scratchpad has been read again.
+    lastCycle = sensors.cycles;
+    for (byte i = 0; i < sensors.count; i++) {
+      Serial.print("Sensor ");
+      Serial.print(i);
+      if (sensors.valid[i]) {
+        Serial.print(": ");
+        Serial.print(sensors.celsius(i));
+        Serial.println(" Celsius");
+      } else {
+        Serial.println(": no reading");
+      }
+    }
+  }
+
+  // ... the rest of the control loop goes here ...
+}
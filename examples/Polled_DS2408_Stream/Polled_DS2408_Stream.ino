@@ -0,0 +1,57 @@
+#include <PolledOneWire.h>
+#include <PolledDS2408.h>
+
+// Fast, non-blocking sampling of the PIO pins of a DS2408, using
+// Channel-Access Read in streaming mode: the device is addressed once, and
+// then sends blocks of 32 samples, each with its CRC16, for as long as we
+// keep reading. Use 10K pull-up resistors on the pins used as inputs.
+
+PolledOneWire  net(10);  // on pin 10
+PolledDS2408  *sw;
+byte lastPio = 0xFF;
+
+void setup(void) {
+  byte addr[8];
+
+  Serial.begin(9600);
+  while (net.search(addr)) {
+    if (PolledOneWire::crc8(addr, 7) == addr[7] && addr[0] == 0x29)
+      break;
+  }
+  net.reset_search();
+  if (addr[0] != 0x29) {
+    Serial.println("No DS2408 found.");
+    return;
+  }
+
+  sw = new PolledDS2408(&net, addr);
+  sw->write(0xFF);  // All output transistors off, so the pins can be read
+  while (sw->status)
+    sw->poll();
+  sw->read_block();
+}
+
+void loop(void) {
+  if (!sw)
+    return;
+
+  if (sw->status) {
+    sw->poll();
+  } else {
+    // A block is in
+    if (sw->block_ok) {
+      for (byte i = 0; i < 32; i++) {
+        if (sw->samples[i] != lastPio) {
+          lastPio = sw->samples[i];
+          Serial.print("PIO = ");
+          Serial.println(lastPio, BIN);
+        }
+      }
+    } else {
+      Serial.println("CRC failure, addressing the DS2408 again");
+    }
+    sw->read_block();
+  }
+
+  // ... the rest of the control loop goes here ...
+}
@@ -0,0 +1,41 @@
+#include <PolledOneWire.h>
+#include <PolledOneWireMemory.h>
+
+// Non-blocking programming of the first DS2431 or DS28EC20 on a bus.
+//
+// Each 8-byte row (DS2431) or 32-byte page (DS28EC20) is loaded into the
+// scratchpad, read back and checked, and copied with the strong pullup on
+// for tPROG. loop() keeps running all the while, including the 10 ms of
+// each copy.
+
+PolledOneWire        net(6);  // on pin 6, with a 4.7K pullup to +Vcc
+PolledOneWireMemory  mem(&net);
+byte addr[8];
+byte data[32] = "Asset 0001, provisioned polled";
+bool writing = false;
+
+void setup(void) {
+  Serial.begin(9600);
+  while (net.search(addr)) {
+    if (PolledOneWire::crc8(addr, 7) == addr[7]
+        && PolledOneWireMemory::block_size(addr[0])) {
+      writing = mem.write(addr, 0, data, sizeof(data));
+      return;
+    }
+  }
+  Serial.println("No DS2431 or DS28EC20 found.");
+}
+
+void loop(void) {
+  if (mem.status) {
+    mem.poll();
+  } else if (writing) {
+    writing = false;
+    if (mem.result == ONEWIRE_MEMORY_OK)
+      Serial.println("Written and verified.");
+    else
+      Serial.println("Write failed.");
+  }
+
+  // ... the rest of the work goes here ...
+}
@@ -0,0 +1,51 @@
+#include <PolledOneWire.h>
+#include <PolledOneWireMemory.h>
+
+// Non-blocking dump of every DS2502, DS2505, DS2433, DS2431 and DS28EC20
+// memory on a bus. Each device is addressed once and streamed page by
+// page; the pages are printed as they come in, while loop() is free for
+// other work.
+
+PolledOneWire        net(6);  // on pin 6, with a 4.7K pullup to +Vcc
+PolledOneWireMemory  mem(&net);
+byte addr[8];
+bool searching = true;
+
+void printPage(uint8_t page, const uint8_t *data, bool ok) {
+  Serial.print("Page ");
+  Serial.print(page);
+  if (!ok) {
+    Serial.println(": CRC error");
+    return;
+  }
+  Serial.print(":");
+  for (byte i = 0; i < ONEWIRE_MEMORY_PAGE_SIZE; i++) {
+    Serial.print(" ");
+    Serial.print(data[i], HEX);
+  }
+  Serial.println();
+}
+
+void setup(void) {
+  Serial.begin(9600);
+}
+
+void loop(void) {
+  if (mem.status) {
+    mem.poll();
+  } else if (searching) {
+    // Next memory device on the bus
+    if (!net.search(addr)) {
+      net.reset_search();
+      searching = false;
+      Serial.println("Done.");
+    } else if (PolledOneWire::crc8(addr, 7) == addr[7]
+        && PolledOneWireMemory::page_count(addr[0])) {
+      Serial.print("Family 0x");
+      Serial.println(addr[0], HEX);
+      mem.read(addr, printPage);
+    }
+  }
+
+  // ... the rest of the work goes here ...
+}
@@ -0,0 +1,183 @@
+/*
+Host-side benchmark of the 1-Wire CRC8 and CRC16 methods.
+
+Compares bit-at-a-time, nibble table and byte table versions of both CRCs,
+and the library's own crc8() and crc16() as configured by
+ONEWIRE_CRC8_TABLE and ONEWIRE_CRC16_TABLE. Build from the library
+directory with the host simulation backend (see README.md), e.g.:
+
+    g++ -O2 -DONEWIRE_HOST_SIM -DONEWIRE_CRC16_TABLE=1 -I. \
+        extras/crc_benchmark/crc_benchmark.cpp PolledOneWire.cpp PolledOneWireSim.cpp
+
+Host timings only show the relative cost of the methods; on an AVR the
+table versions also pay for reading flash.
+*/
+
+#include "PolledOneWire.h"
+#include <stdio.h>
+#include <time.h>
+
+#define BUF_LEN		32		// a DS2431 / DS2502 memory page
+#define ROUNDS		200000
+
+static uint8_t crc8_byte_table[256];
+static uint8_t crc8_nibble_lo[16], crc8_nibble_hi[16];
+static uint16_t crc16_byte_table[256];
+static uint16_t crc16_nibble_table[16];
+
+static uint8_t crc8_bitwise(const uint8_t *p, uint16_t len)
+{
+	uint8_t crc = 0;
+
+	while (len--) {
+		uint8_t inbyte = *p++;
+		for (uint8_t i = 8; i; i--) {
+			uint8_t mix = (crc ^ inbyte) & 0x01;
+			crc >>= 1;
+			if (mix) crc ^= 0x8C;
+			inbyte >>= 1;
+		}
+	}
+	return crc;
+}
+
+static uint8_t crc8_nibble(const uint8_t *p, uint16_t len)
+{
+	uint8_t crc = 0;
+
+	while (len--) {
+		uint8_t i = crc ^ *p++;
+		crc = crc8_nibble_lo[i & 0x0F] ^ crc8_nibble_hi[i >> 4];
+	}
+	return crc;
+}
+
+static uint8_t crc8_table(const uint8_t *p, uint16_t len)
+{
+	uint8_t crc = 0;
+
+	while (len--)
+		crc = crc8_byte_table[crc ^ *p++];
+	return crc;
+}
+
+static uint16_t crc16_bitwise(const uint8_t *p, uint16_t len)
+{
+	uint16_t crc = 0;
+
+	while (len--) {
+		crc ^= *p++;
+		for (uint8_t i = 8; i; i--)
+			crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : (crc >> 1);
+	}
+	return crc;
+}
+
+static uint16_t crc16_nibble(const uint8_t *p, uint16_t len)
+{
+	uint16_t crc = 0;
+
+	while (len--) {
+		crc ^= *p++;
+		crc = (crc >> 4) ^ crc16_nibble_table[crc & 0x0F];
+		crc = (crc >> 4) ^ crc16_nibble_table[crc & 0x0F];
+	}
+	return crc;
+}
+
+static uint16_t crc16_table(const uint8_t *p, uint16_t len)
+{
+	uint16_t crc = 0;
+
+	while (len--)
+		crc = (crc >> 8) ^ crc16_byte_table[(crc ^ *p++) & 0xFF];
+	return crc;
+}
+
+static uint8_t crc8_library(const uint8_t *p, uint16_t len)
+{
+	return PolledOneWire::crc8((uint8_t *) p, len);
+}
+
+static uint16_t crc16_library(const uint8_t *p, uint16_t len)
+{
+	return PolledOneWire::crc16((uint8_t *) p, len);
+}
+
+static void make_tables()
+{
+	uint8_t b;
+
+	for (int i = 0; i < 256; i++) {
+		b = i;
+		crc8_byte_table[i] = crc8_bitwise(&b, 1);
+		crc16_byte_table[i] = crc16_bitwise(&b, 1);
+	}
+	for (int i = 0; i < 16; i++) {
+		crc8_nibble_lo[i] = crc8_byte_table[i];
+		crc8_nibble_hi[i] = crc8_byte_table[i << 4];
+		uint16_t c = i;
+		for (uint8_t j = 4; j; j--)
+			c = (c & 1) ? (c >> 1) ^ 0xA001 : (c >> 1);
+		crc16_nibble_table[i] = c;
+	}
+}
+
+static double now_ns()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static volatile uint16_t sink;
+
+static void bench8(const char *name, uint8_t (*fn)(const uint8_t *, uint16_t), uint8_t *buf, uint8_t expect)
+{
+	double start = now_ns();
+	for (long r = 0; r < ROUNDS; r++) {
+		buf[0] = r;
+		sink += fn(buf, BUF_LEN);
+	}
+	double ns = (now_ns() - start) / ((double) ROUNDS * BUF_LEN);
+	buf[0] = 0;
+	printf("  %-10s %6.2f ns/byte  %s\n", name, ns, fn(buf, BUF_LEN) == expect ? "ok" : "MISMATCH");
+}
+
+static void bench16(const char *name, uint16_t (*fn)(const uint8_t *, uint16_t), uint8_t *buf, uint16_t expect)
+{
+	double start = now_ns();
+	for (long r = 0; r < ROUNDS; r++) {
+		buf[0] = r;
+		sink += fn(buf, BUF_LEN);
+	}
+	double ns = (now_ns() - start) / ((double) ROUNDS * BUF_LEN);
+	buf[0] = 0;
+	printf("  %-10s %6.2f ns/byte  %s\n", name, ns, fn(buf, BUF_LEN) == expect ? "ok" : "MISMATCH");
+}
+
+int main()
+{
+	uint8_t buf[BUF_LEN];
+
+	make_tables();
+	for (int i = 0; i < BUF_LEN; i++)
+		buf[i] = i * 37 + 11;
+	buf[0] = 0;
+
+	uint8_t expect8 = crc8_bitwise(buf, BUF_LEN);
+	printf("CRC8 (ONEWIRE_CRC8_TABLE=%d), %d byte buffer\n", ONEWIRE_CRC8_TABLE, BUF_LEN);
+	bench8("bitwise", crc8_bitwise, buf, expect8);
+	bench8("nibble", crc8_nibble, buf, expect8);
+	bench8("table", crc8_table, buf, expect8);
+	bench8("library", crc8_library, buf, expect8);
+
+	uint16_t expect16 = crc16_bitwise(buf, BUF_LEN);
+	printf("CRC16 (ONEWIRE_CRC16_TABLE=%d), %d byte buffer\n", ONEWIRE_CRC16_TABLE, BUF_LEN);
+	bench16("bitwise", crc16_bitwise, buf, expect16);
+	bench16("nibble", crc16_nibble, buf, expect16);
+	bench16("table", crc16_table, buf, expect16);
+	bench16("library", crc16_library, buf, expect16);
+	return 0;
+}
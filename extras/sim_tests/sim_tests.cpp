@@ -0,0 +1,178 @@
+/*
+Host regression tests for PolledOneWire and its add-on classes, run on the
+simulated bus (see README.md). Each test builds a bus of slave models,
+drives it through the blocking, polled, queued or add-on API, and checks
+the data that comes back and that OneWireSim::violations stays 0.
+
+This file has main(), the helpers in sim_tests.h, and checks of the
+simulator itself; the test_*.cpp files test the library. Build and run them
+with make in this directory. The Makefile also builds them with the optional
+features on, and under the address and undefined behaviour sanitizers, and
+compiles the library with each feature that can be turned off, off. The
+program exits with 1 if any check failed.
+*/
+
+#include "sim_tests.h"
+
+static int checks, failures;
+static const char *testName;
+
+void check( bool ok, const char *what, int line )
+{
+	checks++;
+	if (ok)
+		return;
+	failures++;
+	printf("  FAIL %s line %d: %s\n", testName, line, what);
+}
+
+void begin_test( const char *name )
+{
+	testName = name;
+	OneWireSim::clear();
+	OneWireSim::reset_low_max = 960;
+}
+
+void end_test()
+{
+	CHECK(OneWireSim::violations == 0);
+	printf("%-12s done, %lu us on the bus\n", testName, OneWireSim::now);
+}
+
+void make_rom( uint8_t *rom, uint8_t family, uint8_t serial )
+{
+	rom[0] = family;
+	for (uint8_t i = 1; i < 7; i++)
+		rom[i] = serial + i;
+	rom[7] = PolledOneWire::crc8(rom, 7);
+}
+
+//
+// Wait for a PolledOneWire operation, letting the timer interrupt poll it
+// when that is how it is polled.
+//
+void run( PolledOneWire &ow )
+{
+#if ONEWIRE_TIMER_POLL
+	ow.start_timer_poll();
+	while (ow.poll_status)
+		delayMicroseconds(1);
+#else
+	while (ow.poll_status)
+		ow.poll();
+#endif
+}
+
+void convert_all( PolledOneWire &ow )
+{
+	ow.reset();
+	ow.skip();
+	ow.write(0x44);
+	delay(800);
+}
+
+int16_t temperature( const uint8_t *sp )
+{
+	return (int16_t) (sp[1] << 8 | sp[0]);
+}
+
+//
+// Hold the line low for us, as a master would, with nothing in between.
+//
+static void drive_low( uint8_t pin, unsigned int us )
+{
+	volatile IO_REG_TYPE *reg = PIN_TO_BASEREG(pin);
+	IO_REG_TYPE mask = PIN_TO_BITMASK(pin);
+
+	noInterrupts();
+	DIRECT_WRITE_LOW(reg, mask);
+	DIRECT_MODE_OUTPUT(reg, mask);
+	delayMicroseconds(us);
+	DIRECT_MODE_INPUT(reg, mask);
+	interrupts();
+	delayMicroseconds(100);
+}
+
+//
+// The simulator itself: the clock, the slave models answering the blocking
+// API, and the timing checks that every other test relies on.
+//
+static void test_sim()
+{
+	uint8_t rom[8], got[8];
+
+	begin_test("sim");
+	make_rom(rom, 0x28, 1);
+	OneWireSimDS18x20 t(rom);
+	OneWireSim::attach(BUS_PIN, &t);
+	PolledOneWire ow(BUS_PIN);
+
+	delay(5);
+	CHECK(OneWireSim::now >= 5000);
+	CHECK(ow.reset());
+	ow.write(0x33);	// Read ROM
+	ow.read_bytes(got, 8);
+	CHECK(memcmp(got, rom, 8) == 0);
+	CHECK(OneWireSim::violations == 0);
+	CHECK(OneWireSim::max_critical > 0 && OneWireSim::max_critical < 100);
+
+	// A low too long for a slot and too short for a reset
+	CHECK(ow.reset());
+	drive_low(BUS_PIN, 200);
+	CHECK(OneWireSim::violations == 1);
+	// A reset low held into a power-on reset gets no presence pulse
+	drive_low(BUS_PIN, 1200);
+	CHECK(OneWireSim::violations == 2);
+	CHECK(OneWireSim::max_critical >= 1200);
+	OneWireSim::violations = 0;
+	CHECK(ow.reset());
+
+	t.present = false;
+	CHECK(!ow.reset());
+	end_test();
+}
+
+int main()
+{
+	test_sim();
+#if ONEWIRE_SEARCH
+	test_search();
+	test_target_search();
+	test_verify();
+#endif
+#if ONEWIRE_TIMER_POLL
+	test_timer();
+#endif
+	test_buffers();
+	test_crc_check();
+	test_crc();
+	test_wait_ready();
+	test_overdrive();
+	test_slots();
+	test_queue();
+#if ONEWIRE_STATS
+	test_stats();
+#endif
+	test_batch();
+	test_batch_full();
+#if ONEWIRE_RESUME
+	test_resume();
+#endif
+	test_overrun();
+	test_scheduler();
+	test_partial_reads();
+	test_ds2408();
+	test_memory_read();
+	test_memory_write();
+	test_ds2482();
+	test_multi();
+#if ONEWIRE_SEARCH
+	test_registry();
+	test_rescan();
+#endif
+#if ONEWIRE_PIN_TEMPLATE
+	test_pin();
+#endif
+	printf("%d checks, %d failed\n", checks, failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,77 @@
+#ifndef sim_tests_h
+#define sim_tests_h
+
+// Shared by the host regression tests, see sim_tests.cpp. Each test_*.cpp
+// holds the tests of one part of the library.
+
+#include "PolledOneWire.h"
+#include <stdio.h>
+
+#define BUS_PIN		10
+
+#define CHECK(cond) check((cond), #cond, __LINE__)
+
+void check( bool ok, const char *what, int line );
+void begin_test( const char *name );
+void end_test();
+void make_rom( uint8_t *rom, uint8_t family, uint8_t serial );
+void run( PolledOneWire &ow );
+void convert_all( PolledOneWire &ow );
+int16_t temperature( const uint8_t *sp );
+
+//
+// Wait for an add-on class. With the timer, its poll() only moves on to
+// the next step, so time has to pass in between.
+//
+template <class T>
+void finish( T &dev )
+{
+	while (dev.status) {
+		dev.poll();
+#if ONEWIRE_TIMER_POLL
+		delayMicroseconds(1);
+#endif
+	}
+}
+
+// The tests
+#if ONEWIRE_SEARCH
+void test_search();
+void test_target_search();
+void test_verify();
+#endif
+#if ONEWIRE_TIMER_POLL
+void test_timer();
+#endif
+void test_queue();
+void test_multi();
+void test_overdrive();
+#if ONEWIRE_PIN_TEMPLATE
+void test_pin();
+#endif
+#if ONEWIRE_STATS
+void test_stats();
+#endif
+void test_buffers();
+void test_crc_check();
+void test_crc();
+void test_scheduler();
+void test_wait_ready();
+#if ONEWIRE_SEARCH
+void test_registry();
+void test_rescan();
+#endif
+void test_ds2482();
+void test_batch();
+void test_batch_full();
+void test_partial_reads();
+void test_ds2408();
+void test_memory_read();
+void test_memory_write();
+#if ONEWIRE_RESUME
+void test_resume();
+#endif
+void test_overrun();
+void test_slots();
+
+#endif
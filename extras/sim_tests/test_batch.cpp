@@ -0,0 +1,93 @@
+#include "sim_tests.h"
+
+//
+// Four sensors read in one job, in full with CRC8 and just their
+// temperature bytes, then with one and with all of them gone.
+//
+void test_batch()
+{
+	uint8_t roms[4][8], sp[4][9], temp[4][2], result[4];
+	OneWireSimDS18x20 *t[4];
+
+	begin_test("batch");
+	for (uint8_t i = 0; i < 4; i++) {
+		make_rom(roms[i], 0x28, i * 16);
+		t[i] = new OneWireSimDS18x20(roms[i]);
+		t[i]->temperature = (20 + i) * 16;
+		OneWireSim::attach(BUS_PIN, t[i]);
+	}
+	PolledOneWire ow(BUS_PIN);
+	convert_all(ow);
+
+	ow.polled_read_batch(roms, 4, sp[0], result);
+	run(ow);
+	for (uint8_t i = 0; i < 4; i++) {
+		CHECK(result[i] == ONEWIRE_BATCH_OK);
+		CHECK(temperature(sp[i]) == (20 + i) * 16);
+	}
+
+	// Just the temperature bytes, no CRC
+	ow.polled_read_batch(roms, 4, temp[0], result, 0xBE, 2, ONEWIRE_CRC_NONE);
+	run(ow);
+	for (uint8_t i = 0; i < 4; i++) {
+		CHECK(result[i] == ONEWIRE_BATCH_OK);
+		CHECK(temperature(temp[i]) == (20 + i) * 16);
+	}
+
+	// One gone reads as all ones, all gone is no presence
+	t[2]->present = false;
+	ow.polled_read_batch(roms, 4, sp[0], result);
+	run(ow);
+	CHECK(result[1] == ONEWIRE_BATCH_OK);
+	CHECK(result[2] == ONEWIRE_BATCH_CRC_ERROR);
+	CHECK(result[3] == ONEWIRE_BATCH_OK);
+	for (uint8_t i = 0; i < 4; i++)
+		t[i]->present = false;
+	ow.polled_read_batch(roms, 4, sp[0], result);
+	run(ow);
+	for (uint8_t i = 0; i < 4; i++)
+		CHECK(result[i] == ONEWIRE_BATCH_NO_PRESENCE);
+	for (uint8_t i = 0; i < 4; i++)
+		delete t[i];
+	end_test();
+}
+
+//
+// The largest batch, without CRC so that it ends with a reset: it has to
+// finish, not wrap round to the first device again.
+//
+void test_batch_full()
+{
+	static uint8_t roms[255][8], temp[255][2], result[255];
+	unsigned long limit;
+
+	begin_test("batch full");
+	make_rom(roms[0], 0x28, 1);
+	OneWireSimDS18x20 t(roms[0]);
+	t.temperature = 25 * 16;
+	OneWireSim::attach(BUS_PIN, &t);
+	for (uint8_t i = 1; i < 255; i++)
+		memcpy(roms[i], roms[0], 8);
+	PolledOneWire ow(BUS_PIN);
+	convert_all(ow);
+
+	memset(result, 0xFF, sizeof(result));
+	ow.polled_read_batch(roms, 255, temp[0], result, 0xBE, 2, ONEWIRE_CRC_NONE);
+	limit = OneWireSim::now + 5000000;
+#if ONEWIRE_TIMER_POLL
+	ow.start_timer_poll();
+	while (ow.poll_status && OneWireSim::now < limit)
+		delayMicroseconds(1);
+#else
+	while (ow.poll_status && OneWireSim::now < limit)
+		ow.poll();
+#endif
+	CHECK(!ow.poll_status);
+	ow.poll_status = 0;
+	OneWireSim::timer_armed = false;
+	for (uint8_t i = 0; i < 255; i++) {
+		CHECK(result[i] == ONEWIRE_BATCH_OK);
+		CHECK(temperature(temp[i]) == 25 * 16);
+	}
+	end_test();
+}
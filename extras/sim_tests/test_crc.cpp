@@ -0,0 +1,64 @@
+#include "sim_tests.h"
+
+//
+// Bit at a time references for the table versions.
+//
+static uint8_t crc8_bitwise( const uint8_t *p, uint16_t len )
+{
+	uint8_t crc = 0;
+
+	while (len--) {
+		uint8_t b = *p++;
+		for (uint8_t i = 0; i < 8; i++) {
+			uint8_t mix = (crc ^ b) & 0x01;
+			crc >>= 1;
+			if (mix)
+				crc ^= 0x8C;
+			b >>= 1;
+		}
+	}
+	return crc;
+}
+
+static uint16_t crc16_bitwise( const uint8_t *p, uint16_t len )
+{
+	uint16_t crc = 0;
+
+	while (len--) {
+		crc ^= *p++;
+		for (uint8_t i = 0; i < 8; i++)
+			crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+	}
+	return crc;
+}
+
+//
+// crc8() and crc16(), whichever way ONEWIRE_CRC8_TABLE and
+// ONEWIRE_CRC16_TABLE build them, agree with the references.
+//
+void test_crc()
+{
+	uint8_t buf[64];
+	uint16_t crc;
+	uint32_t seed = 1;
+	bool ok8 = true, ok16 = true, okUpdate = true;
+
+	begin_test("crc_table");
+	for (uint16_t round = 0; round < 200; round++) {
+		uint8_t len = round % sizeof(buf) + 1;
+		for (uint8_t i = 0; i < len; i++) {
+			seed = seed * 1103515245 + 12345;
+			buf[i] = seed >> 16;
+		}
+		ok8 = ok8 && PolledOneWire::crc8(buf, len) == crc8_bitwise(buf, len);
+		ok16 = ok16 && PolledOneWire::crc16(buf, len) == crc16_bitwise(buf, len);
+		crc = 0;
+		for (uint8_t i = 0; i < len; i++)
+			crc = PolledOneWire::crc16_update(crc, buf[i]);
+		okUpdate = okUpdate && crc == crc16_bitwise(buf, len);
+	}
+	CHECK(ok8);
+	CHECK(ok16);
+	CHECK(okUpdate);
+	end_test();
+}
@@ -0,0 +1,40 @@
+#include "sim_tests.h"
+#include "PolledDS2408.h"
+
+//
+// Channel-Access blocks streamed in, outputs written between them, and the
+// stream ended.
+//
+void test_ds2408()
+{
+	uint8_t rom[8];
+
+	begin_test("ds2408");
+	make_rom(rom, 0x29, 1);
+	OneWireSimDS2408 d(rom);
+	d.pio_input = 0xA5;
+	OneWireSim::attach(BUS_PIN, &d);
+	PolledOneWire ow(BUS_PIN);
+	PolledDS2408 sw(&ow, rom);
+
+	for (uint8_t b = 0; b < 3; b++) {
+		sw.read_block();
+		finish(sw);
+		CHECK(sw.block_ok);
+		CHECK(sw.samples[0] == 0xA5 && sw.samples[31] == 0xA5);
+	}
+	CHECK(d.samples >= 96);
+	for (uint8_t v = 0; v < 3; v++) {
+		sw.write(0xF0 | v);
+		finish(sw);
+		CHECK(sw.write_ok);
+		CHECK(d.regs[1] == (0xF0 | v));
+	}
+	sw.read_block();
+	finish(sw);
+	CHECK(sw.block_ok);
+	sw.end();
+	finish(sw);
+	CHECK(sw.errors == 0);
+	end_test();
+}
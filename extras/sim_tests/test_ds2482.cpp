@@ -0,0 +1,100 @@
+#include "sim_tests.h"
+#include "PolledDS2482.h"
+
+//
+// A DS2482-800 with three sensors on each of two channels: found by the
+// bridge's search, as PolledOneWire's would find them, converted with the
+// strong pullup and read back, and polled while the bridge says it is busy.
+//
+void test_ds2482()
+{
+	uint8_t roms[6][8], sp[9];
+	uint8_t pins[2] = { 20, 21 };
+	OneWireSimDS18x20 *t[6];
+	uint8_t n;
+
+	begin_test("ds2482");
+	for (uint8_t i = 0; i < 6; i++) {
+		make_rom(roms[i], i % 3 ? 0x28 : 0x10, i * 16);
+		t[i] = new OneWireSimDS18x20(roms[i]);
+		t[i]->temperature = (20 + i) * 16;
+		OneWireSim::attach(pins[i / 3], t[i]);
+	}
+	OneWireSimDS2482 fake(0x19, pins, 2);
+	OneWireSim::attach_i2c(&fake);
+	PolledDS2482 absent(0x18);
+	CHECK(!absent.begin());
+	PolledDS2482 br(0x19);
+	CHECK(br.begin());
+
+	for (uint8_t ch = 0; ch < 2; ch++) {
+		CHECK(br.select_channel(ch));
+		br.reset_search();
+		n = 0;
+		do {
+			br.polled_search();
+			while (br.poll_status)
+				br.poll();
+			if (br.search_result) {
+				CHECK(PolledOneWire::crc8(br.readWriteBuffer, 7) == br.readWriteBuffer[7]);
+				n++;
+			}
+		} while (br.search_result);
+		CHECK(n == 3);
+	}
+
+	// The search state is PolledOneWire's: the same order, and a target
+	// search finds the family asked for first
+	PolledOneWire ow(pins[1]);
+	uint8_t addr[8];
+	br.reset_search();
+	while (ow.search(addr)) {
+		br.polled_search();
+		while (br.poll_status)
+			br.poll();
+		CHECK(br.search_result && memcmp(br.readWriteBuffer, addr, 8) == 0);
+	}
+	br.target_search(0x28);
+	br.polled_search();
+	while (br.poll_status)
+		br.poll();
+	CHECK(br.search_result && br.readWriteBuffer[0] == 0x28);
+
+	br.select_channel(0);
+	br.polled_reset();
+	while (br.poll_status)
+		br.poll();
+	CHECK(br.reset_result);
+	br.polled_skip();
+	while (br.poll_status)
+		br.poll();
+	br.polled_write(0x44, 1);
+	while (br.poll_status)
+		br.poll();
+	delay(800);
+	br.depower();
+	br.polled_reset();
+	while (br.poll_status)
+		br.poll();
+	br.polled_select(roms[1]);
+	while (br.poll_status)
+		br.poll();
+	br.polled_write(0xBE);
+	while (br.poll_status)
+		br.poll();
+	br.polled_read_into(sp, 9);
+	while (br.poll_status)
+		br.poll();
+	CHECK(PolledOneWire::crc8(sp, 8) == sp[8]);
+	CHECK(temperature(sp) == 21 * 16);
+
+	// A busy bridge is polled again, not read early
+	fake.busy_reads = 3;
+	br.polled_reset();
+	while (br.poll_status)
+		br.poll();
+	CHECK(br.reset_result);
+	for (uint8_t i = 0; i < 6; i++)
+		delete t[i];
+	end_test();
+}
@@ -0,0 +1,106 @@
+#include "sim_tests.h"
+#include "PolledOneWireMemory.h"
+
+static const uint8_t *memoryRef;
+static int memoryPages, memoryBad;
+
+static void memory_page( uint8_t page, const uint8_t *data, bool ok )
+{
+	memoryPages++;
+	if (!ok || memcmp(data, memoryRef + page * ONEWIRE_MEMORY_PAGE_SIZE, ONEWIRE_MEMORY_PAGE_SIZE))
+		memoryBad++;
+}
+
+//
+// Read pages with m, expecting them to match ref. Also checks that a
+// second read is refused while the first runs.
+//
+static void read_memory( PolledOneWireMemory &m, const uint8_t *rom, const uint8_t *ref,
+	uint8_t first, uint8_t pages, int expect )
+{
+	memoryRef = ref;
+	memoryPages = memoryBad = 0;
+	CHECK(m.read(rom, memory_page, first, pages));
+	CHECK(!m.read(rom, memory_page, first, pages));	// Busy
+	finish(m);
+	CHECK(m.result == ONEWIRE_MEMORY_OK);
+	CHECK(memoryPages == expect && memoryBad == 0);
+}
+
+//
+// Every page of a DS2502, a DS2431 and a DS28EC20, and a range of pages,
+// streamed and checked against the devices' memory.
+//
+void test_memory_read()
+{
+	uint8_t a[8], b[8], c[8];
+
+	begin_test("mem_read");
+	make_rom(a, 0x09, 1);
+	make_rom(b, 0x2D, 2);
+	make_rom(c, 0x43, 3);
+	OneWireSimDS2502 da(a);
+	OneWireSimDS2431 db(b);
+	OneWireSimDS28EC20 *dc = new OneWireSimDS28EC20(c);
+	for (uint8_t i = 0; i < 128; i++) {
+		da.memory[i] = i * 5;
+		db.memory[i] = i * 3;
+	}
+	for (uint16_t i = 0; i < sizeof(dc->memory); i++)
+		dc->memory[i] = i ^ (i >> 8);
+	OneWireSim::attach(BUS_PIN, &da);
+	OneWireSim::attach(BUS_PIN, &db);
+	OneWireSim::attach(BUS_PIN, dc);
+	PolledOneWire ow(BUS_PIN);
+	PolledOneWireMemory m(&ow);
+
+	CHECK(PolledOneWireMemory::page_count(0x43) == 80);
+	CHECK(PolledOneWireMemory::page_count(0x99) == 0);
+	read_memory(m, a, da.memory, 0, 0, 4);
+	read_memory(m, b, db.memory, 0, 0, 4);
+	read_memory(m, c, dc->memory, 0, 0, 80);
+	read_memory(m, c, dc->memory, 10, 5, 5);
+	CHECK(!m.read(a, memory_page, 4, 0));	// Past the end
+	delete dc;
+	end_test();
+}
+
+//
+// Writes to a DS2431 and a DS28EC20 through their scratchpads, checked in
+// the devices' memory and by reading them back, and writes refused.
+//
+void test_memory_write()
+{
+	uint8_t a[8], b[8], c[8], data[64];
+
+	begin_test("mem_write");
+	make_rom(a, 0x09, 1);
+	make_rom(b, 0x2D, 2);
+	make_rom(c, 0x43, 3);
+	OneWireSimDS2502 da(a);
+	OneWireSimDS2431 db(b);
+	OneWireSimDS28EC20 *dc = new OneWireSimDS28EC20(c);
+	OneWireSim::attach(BUS_PIN, &da);
+	OneWireSim::attach(BUS_PIN, &db);
+	OneWireSim::attach(BUS_PIN, dc);
+	PolledOneWire ow(BUS_PIN);
+	PolledOneWireMemory m(&ow);
+
+	for (uint8_t i = 0; i < sizeof(data); i++)
+		data[i] = 0xC0 ^ i;
+	CHECK(m.write(b, 16, data, 32));
+	CHECK(!m.write(b, 16, data, 32));	// Busy
+	finish(m);
+	CHECK(m.result == ONEWIRE_MEMORY_OK && m.blocks_written == 4);
+	CHECK(memcmp(db.memory + 16, data, 32) == 0);
+	CHECK(m.write(c, 64, data, 64));
+	finish(m);
+	CHECK(m.result == ONEWIRE_MEMORY_OK && m.blocks_written == 6);
+	CHECK(memcmp(dc->memory + 64, data, 64) == 0);
+	read_memory(m, c, dc->memory, 2, 2, 2);
+	CHECK(!m.write(b, 3, data, 8));	// Not on a scratchpad boundary
+	CHECK(!m.write(a, 0, data, 8));	// Not an EEPROM
+	CHECK(m.errors == 0);
+	delete dc;
+	end_test();
+}
@@ -0,0 +1,86 @@
+#include "sim_tests.h"
+#include "PolledOneWireMulti.h"
+
+//
+// Three lines on one port and an empty one on another, read in lock step,
+// then with one line held low, and with nothing to transfer.
+//
+void test_multi()
+{
+	uint8_t roms[4][8], sp[4][9];
+	uint8_t *bufs[4] = { sp[0], sp[1], sp[2], sp[3] };
+	const uint8_t *select[4] = { roms[0], roms[1], roms[2], roms[3] };
+	const uint8_t pins[4] = { 8, 9, 11, 20 };	// 20, on another port, is empty
+	OneWireSimDS18x20 *t[3];
+
+	begin_test("multi");
+	make_rom(roms[3], 0x28, 99);
+	for (uint8_t i = 0; i < 3; i++) {
+		make_rom(roms[i], 0x28, i * 16);
+		t[i] = new OneWireSimDS18x20(roms[i]);
+		t[i]->temperature = (10 + i) * 16;
+		OneWireSim::attach(pins[i], t[i]);
+	}
+	PolledOneWireMulti m(pins, 4);
+	CHECK(m.lines_ok == 0x07);
+
+	m.polled_reset();
+	while (m.poll_status)
+		m.poll();
+	CHECK(m.reset_result == 0x07);
+	m.polled_skip();
+	while (m.poll_status)
+		m.poll();
+	m.polled_write(0x44);
+	while (m.poll_status)
+		m.poll();
+	delay(800);
+	m.polled_reset();
+	while (m.poll_status)
+		m.poll();
+	m.polled_select(select);
+	while (m.poll_status)
+		m.poll();
+	m.polled_write(0xBE);
+	while (m.poll_status)
+		m.poll();
+	m.polled_read_bytes(bufs, 9);
+	while (m.poll_status)
+		m.poll();
+	for (uint8_t i = 0; i < 3; i++) {
+		CHECK(PolledOneWire::crc8(sp[i], 8) == sp[i][8]);
+		CHECK(temperature(sp[i]) == (10 + i) * 16);
+	}
+
+	// A line held low is left out of the reset and the slots
+	t[1]->stuck_low = true;
+	m.polled_reset();
+	while (m.poll_status)
+		m.poll();
+	CHECK(m.reset_result == 0x05);
+	m.polled_skip();
+	while (m.poll_status)
+		m.poll();
+	m.polled_write(0xBE);
+	while (m.poll_status)
+		m.poll();
+	m.polled_read_bytes(bufs, 9);
+	while (m.poll_status)
+		m.poll();
+	CHECK(temperature(sp[0]) == 10 * 16 && temperature(sp[2]) == 12 * 16);
+	CHECK(sp[1][0] == 0xFF);
+
+	// Nothing to transfer is done at once, without a slot or a byte stored
+	unsigned long now = OneWireSim::now;
+	sp[0][0] = 0x5A;
+	m.polled_write_bytes(sp[0], 0);
+	CHECK(!m.poll_status);
+	m.polled_write_bytes(select, 0);
+	CHECK(!m.poll_status);
+	m.polled_read_bytes(bufs, 0);
+	CHECK(!m.poll_status);
+	CHECK(OneWireSim::now - now < 10 && sp[0][0] == 0x5A);
+	for (uint8_t i = 0; i < 3; i++)
+		delete t[i];
+	end_test();
+}
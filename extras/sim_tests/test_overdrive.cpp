@@ -0,0 +1,50 @@
+#include "sim_tests.h"
+
+//
+// A DS2431 read at overdrive speed, polled and queued, then a standard
+// speed reset taking it back.
+//
+void test_overdrive()
+{
+	uint8_t rom[8], cmd[3] = { 0xF0, 8, 0 }, out[4];
+
+	begin_test("overdrive");
+	make_rom(rom, 0x2D, 1);
+	OneWireSimDS2431 e(rom);
+	for (uint8_t i = 0; i < 128; i++)
+		e.memory[i] = i * 3;
+	OneWireSim::attach(BUS_PIN, &e);
+	PolledOneWire ow(BUS_PIN);
+
+	ow.polled_reset();
+	run(ow);
+	ow.polled_overdrive_select(rom);
+	run(ow);
+	CHECK(ow.overdrive);
+	ow.polled_reset();
+	run(ow);
+	CHECK(ow.reset_result);
+	ow.polled_skip();
+	run(ow);
+	ow.polled_write_bytes(cmd, 3);
+	run(ow);
+	ow.polled_read_bytes(4);
+	run(ow);
+	for (uint8_t i = 0; i < 4; i++)
+		CHECK(ow.readWriteBuffer[i] == (uint8_t) ((i + 8) * 3));
+
+	// A standard speed reset takes every device back to standard speed
+	ow.overdrive = false;
+	ow.queue_clear();
+	ow.queue_reset();
+	ow.queue_overdrive_select(rom);
+	ow.queue_write(cmd, 3);
+	ow.queue_read(out, 4);
+	ow.queue_start();
+	run(ow);
+	CHECK(ow.queue_result == ONEWIRE_QUEUE_OK);
+	CHECK(out[0] == 24 && out[3] == 33);
+	ow.overdrive = false;
+	CHECK(ow.reset());
+	end_test();
+}
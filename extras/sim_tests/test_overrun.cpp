@@ -0,0 +1,120 @@
+#include "sim_tests.h"
+
+//
+// Poll, holding up the polls that end a reset low. late is how many.
+//
+static int late;
+static bool lastReset;
+
+static void late_poll( PolledOneWire &ow )
+{
+	bool reset = ow.poll_status & ONEWIRE_POLLSTAT_RESET;
+
+	if (late > 0 && reset && lastReset) {
+		OneWireSim::now += 1000;
+		late--;
+	}
+	lastReset = reset;
+	ow.poll();
+}
+
+static void late_run( PolledOneWire &ow, int polls )
+{
+	late = polls;
+	lastReset = false;
+	while (ow.poll_status)
+		late_poll(ow);
+}
+
+#if !ONEWIRE_TIMER_POLL
+//
+// An interrupt handler that takes its time.
+//
+static void slow_isr()
+{
+	delayMicroseconds(600);
+}
+#endif
+
+//
+// Polls late enough to stretch a reset low are caught and retried, by a
+// single reset, a queue and a batch.
+//
+void test_overrun()
+{
+	uint8_t roms[2][8], sp[2][9], result[2];
+	OneWireSimDS18x20 *t[2];
+	unsigned long v;
+
+	begin_test("overrun");
+	for (uint8_t i = 0; i < 2; i++) {
+		make_rom(roms[i], 0x28, i * 16);
+		t[i] = new OneWireSimDS18x20(roms[i]);
+		OneWireSim::attach(BUS_PIN, t[i]);
+	}
+	PolledOneWire ow(BUS_PIN);
+
+	ow.polled_reset();
+	late_run(ow, 0);
+	CHECK(ow.reset_result && !ow.overrun && ow.overruns == 0);
+
+	// The slaves see the long low as a power-on reset, and don't answer
+	// it; those are the violations. The retry finds them.
+	v = OneWireSim::violations;
+	ow.polled_reset();
+	late_run(ow, 1);
+	CHECK(ow.reset_result && !ow.overrun && ow.overruns == 1);
+	CHECK(OneWireSim::violations > v);
+
+	// Every try overruns
+	ow.polled_reset();
+	late_run(ow, 100);
+	CHECK(ow.overrun);
+	CHECK(ow.overruns == 1 + ONEWIRE_OVERRUN_RETRIES + 1);
+
+	ow.queue_clear();
+	ow.queue_reset();
+	ow.queue_select(roms[0]);
+	ow.queue_write_byte(0xBE);
+	ow.queue_read(sp[0], 9);
+	ow.queue_start();
+	late_run(ow, 100);
+	CHECK(ow.queue_result == ONEWIRE_QUEUE_OVERRUN);
+	ow.queue_start();
+	late_run(ow, 0);
+	CHECK(ow.queue_result == ONEWIRE_QUEUE_OK);
+
+	// A batch reads a device again after an overrun
+	ow.polled_read_batch(roms, 2, sp[0], result);
+	late_run(ow, 2 * (ONEWIRE_OVERRUN_RETRIES + 1));
+	CHECK(result[0] == ONEWIRE_BATCH_OK && result[1] == ONEWIRE_BATCH_OK);
+	ow.batch_retries = 0;
+	ow.polled_read_batch(roms, 2, sp[0], result);
+	late_run(ow, 2 * (ONEWIRE_OVERRUN_RETRIES + 1));
+	CHECK(result[0] == ONEWIRE_BATCH_OVERRUN && result[1] == ONEWIRE_BATCH_OK);
+
+#if !ONEWIRE_TIMER_POLL
+	// An interrupt landing around the end of the reset low: whenever it
+	// made the low too long for the slaves, the reset has to know
+	OneWireSim::timer_handler = slow_isr;
+	for (unsigned long at = 495; at < 510; at++) {
+		unsigned long overruns = ow.overruns;
+
+		v = OneWireSim::violations;
+		ow.polled_reset();
+		OneWireSim::timer_at = OneWireSim::now + at;
+		OneWireSim::timer_armed = true;
+		late_run(ow, 0);
+		CHECK(OneWireSim::violations == v || ow.overruns > overruns);
+		CHECK(ow.reset_result);
+	}
+	OneWireSim::timer_armed = false;
+	OneWireSim::timer_handler = 0;
+#endif
+	for (uint8_t i = 0; i < 2; i++)
+		delete t[i];
+
+	// Late polls are expected to have been seen above
+	OneWireSim::violations = 0;
+	end_test();
+}
@@ -0,0 +1,32 @@
+#include "sim_tests.h"
+
+#if ONEWIRE_PIN_TEMPLATE
+#include "PolledOneWirePin.h"
+
+//
+// The template class, driven through its PolledOneWire base.
+//
+void test_pin()
+{
+	uint8_t rom[8], sp[9];
+
+	begin_test("pin");
+	make_rom(rom, 0x28, 1);
+	OneWireSimDS18x20 t(rom);
+	t.temperature = 33 * 16;
+	OneWireSim::attach(BUS_PIN, &t);
+	PolledOneWirePin<BUS_PIN> ow;
+
+	convert_all(ow);
+	ow.polled_reset();
+	run(ow);
+	ow.polled_select(rom);
+	run(ow);
+	ow.polled_write(0xBE);
+	run(ow);
+	ow.polled_read_into(sp, 9, ONEWIRE_CRC_8);
+	run(ow);
+	CHECK(ow.crc_ok && temperature(sp) == 33 * 16);
+	end_test();
+}
+#endif
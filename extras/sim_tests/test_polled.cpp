@@ -0,0 +1,163 @@
+#include "sim_tests.h"
+
+//
+// Polled reads and writes straight from and into the caller's buffers,
+// longer than readWriteBuffer, which they leave alone.
+//
+void test_buffers()
+{
+	uint8_t rom[8], mem[128], cmd[3] = { 0xF0, 0, 0 }, sp[11];
+	uint8_t i;
+
+	begin_test("buffers");
+	make_rom(rom, 0x2D, 1);
+	OneWireSimDS2431 e(rom);
+	for (i = 0; i < 128; i++)
+		e.memory[i] = i * 7;
+	OneWireSim::attach(BUS_PIN, &e);
+	PolledOneWire ow(BUS_PIN);
+	memset(ow.readWriteBuffer, 0x5A, sizeof(ow.readWriteBuffer));
+
+	ow.polled_reset();
+	run(ow);
+	ow.polled_skip();
+	run(ow);
+	ow.polled_write_from(cmd, 3);
+	run(ow);
+	ow.polled_read_into(mem, sizeof(mem));
+	run(ow);
+	CHECK(memcmp(mem, e.memory, sizeof(mem)) == 0);
+	for (i = 0; i < sizeof(ow.readWriteBuffer); i++)
+		CHECK(ow.readWriteBuffer[i] == 0x5A);
+
+	// Write Scratchpad from the caller's buffer, and read it back
+	cmd[0] = 0x0F;
+	cmd[1] = 0x10;
+	cmd[2] = 0x00;
+	ow.polled_reset();
+	run(ow);
+	ow.polled_skip();
+	run(ow);
+	ow.polled_write_from(cmd, 3);
+	run(ow);
+	ow.polled_write_from(mem, 8);
+	run(ow);
+	cmd[0] = 0xAA;
+	ow.polled_reset();
+	run(ow);
+	ow.polled_skip();
+	run(ow);
+	ow.polled_write_from(cmd, 1);
+	run(ow);
+	ow.polled_read_into(sp, sizeof(sp));
+	run(ow);
+	CHECK(sp[0] == 0x10 && sp[1] == 0x00 && sp[2] == 0x07);	// TA1, TA2, E/S
+	CHECK(memcmp(sp + 3, mem, 8) == 0);
+	end_test();
+}
+
+//
+// The CRCs against known values, and checked as the bytes come in: a
+// DS18B20 scratchpad with CRC8, and DS2408 registers with a CRC16 that
+// also covers the command, passed in as the seed.
+//
+void test_crc_check()
+{
+	uint8_t rom[8] = { 0x02, 0x1C, 0xB8, 0x01, 0x00, 0x00, 0x00, 0xA2 };
+	uint8_t digits[9] = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+	uint8_t trom[8], srom[8], sp[9], cmd[3] = { 0xF0, 0x88, 0x00 }, regs[10];
+
+	begin_test("crc");
+	CHECK(PolledOneWire::crc8(rom, 7) == rom[7]);
+	CHECK(PolledOneWire::crc16(digits, 9) == 0xBB3D);
+
+	make_rom(trom, 0x28, 1);
+	make_rom(srom, 0x29, 2);
+	OneWireSimDS18x20 t(trom);
+	t.temperature = 21 * 16 + 5;
+	OneWireSimDS2408 sw(srom);
+	sw.pio_input = 0x3C;
+	OneWireSim::attach(BUS_PIN, &t);
+	OneWireSim::attach(BUS_PIN, &sw);
+	PolledOneWire ow(BUS_PIN);
+	convert_all(ow);
+
+	ow.polled_reset();
+	run(ow);
+	ow.polled_select(trom);
+	run(ow);
+	ow.polled_write(0xBE);
+	run(ow);
+	ow.polled_read_into(sp, 9, ONEWIRE_CRC_8);
+	run(ow);
+	CHECK(ow.crc_ok);
+	CHECK(temperature(sp) == 21 * 16 + 5);
+
+	// The CRC byte left out
+	ow.polled_reset();
+	run(ow);
+	ow.polled_select(trom);
+	run(ow);
+	ow.polled_write(0xBE);
+	run(ow);
+	ow.polled_read_into(sp, 8, ONEWIRE_CRC_8);
+	run(ow);
+	CHECK(!ow.crc_ok);
+
+	for (uint8_t seeded = 0; seeded < 2; seeded++) {
+		ow.polled_reset();
+		run(ow);
+		ow.polled_select(srom);
+		run(ow);
+		ow.polled_write_from(cmd, 3);
+		run(ow);
+		ow.polled_read_into(regs, 10, ONEWIRE_CRC_16, seeded ? PolledOneWire::crc16(cmd, 3) : 0);
+		run(ow);
+		CHECK(ow.crc_ok == seeded);
+		CHECK(regs[0] == 0x3C);
+	}
+	end_test();
+}
+
+//
+// polled_wait_ready() ends when the DS18B20 signals the end of its
+// conversion with read slots, or at the timeout.
+//
+void test_wait_ready()
+{
+	uint8_t rom[8];
+
+	begin_test("wait_ready");
+	make_rom(rom, 0x28, 1);
+	OneWireSimDS18x20 t(rom);
+	OneWireSim::attach(BUS_PIN, &t);
+	PolledOneWire ow(BUS_PIN);
+
+	t.conversion_us = 20000;
+	ow.polled_reset();
+	run(ow);
+	ow.polled_skip();
+	run(ow);
+	ow.polled_write(0x44);
+	run(ow);
+	unsigned long start = OneWireSim::now;
+	ow.polled_wait_ready(750000, 1000);
+	run(ow);
+	CHECK(ow.ready_result);
+	CHECK(OneWireSim::now - start < 30000);
+	CHECK(t.conversions == 1);
+
+	t.conversion_us = 500000;
+	ow.polled_reset();
+	run(ow);
+	ow.polled_skip();
+	run(ow);
+	ow.polled_write(0x44);
+	run(ow);
+	start = OneWireSim::now;
+	ow.polled_wait_ready(100000, 1000);
+	run(ow);
+	CHECK(!ow.ready_result);
+	CHECK(OneWireSim::now - start >= 100000 && OneWireSim::now - start < 110000);
+	end_test();
+}
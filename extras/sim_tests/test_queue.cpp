@@ -0,0 +1,58 @@
+#include "sim_tests.h"
+
+//
+// A queued transaction with a powered step, run twice, then against an
+// empty bus, and a queue filled up.
+//
+void test_queue()
+{
+	uint8_t rom[8], sp[9];
+
+	begin_test("queue");
+	make_rom(rom, 0x28, 1);
+	OneWireSimDS18x20 t(rom, true);
+	t.temperature = -10 * 16;
+	OneWireSim::attach(BUS_PIN, &t);
+	PolledOneWire ow(BUS_PIN);
+
+	// Parasite powered conversion with the strong pullup for its time
+	ow.queue_clear();
+	CHECK(ow.queue_reset());
+	CHECK(ow.queue_skip());
+	CHECK(ow.queue_write_byte(0x44, 1));
+	CHECK(ow.queue_power(750000));
+	ow.queue_start();
+	run(ow);
+	CHECK(ow.queue_result == ONEWIRE_QUEUE_OK);
+	CHECK(t.conversions == 1 && !t.conversion_failed);
+
+	ow.queue_clear();
+	ow.queue_reset();
+	ow.queue_select(rom);
+	ow.queue_write_byte(0xBE);
+	ow.queue_read(sp, 9);
+	// The same transaction runs again
+	for (uint8_t i = 0; i < 2; i++) {
+		memset(sp, 0, sizeof(sp));
+		ow.queue_start();
+		run(ow);
+		CHECK(ow.queue_result == ONEWIRE_QUEUE_OK);
+		CHECK(PolledOneWire::crc8(sp, 8) == sp[8]);
+		CHECK(temperature(sp) == -10 * 16);
+	}
+
+	// Nobody there: stops after the reset
+	t.present = false;
+	memset(sp, 0, sizeof(sp));
+	ow.queue_start();
+	run(ow);
+	CHECK(ow.queue_result == ONEWIRE_QUEUE_NO_PRESENCE);
+	CHECK(sp[0] == 0);
+
+	// Full
+	ow.queue_clear();
+	for (uint8_t i = 0; i < ONEWIRE_MAX_QUEUE_LEN; i++)
+		CHECK(ow.queue_delay(10));
+	CHECK(!ow.queue_delay(10));
+	end_test();
+}
@@ -0,0 +1,85 @@
+#include "sim_tests.h"
+#include "PolledOneWireRegistry.h"
+
+#if ONEWIRE_SEARCH
+//
+// A scan into the table, looked up by ROM and by family, saved to and
+// loaded from EEPROM, then a scan of more devices than fit.
+//
+void test_registry()
+{
+	uint8_t roms[ONEWIRE_REGISTRY_MAX_DEVICES + 2][8];
+	OneWireSimDS18x20 *t[ONEWIRE_REGISTRY_MAX_DEVICES + 2];
+	const uint8_t total = ONEWIRE_REGISTRY_MAX_DEVICES + 2;
+	PolledOneWireRegistry reg, loaded;
+	uint8_t i;
+
+	begin_test("registry");
+	for (i = 0; i < total; i++) {
+		make_rom(roms[i], i % 2 ? 0x28 : 0x10, i * 8);
+		t[i] = new OneWireSimDS18x20(roms[i]);
+		if (i < 4)
+			OneWireSim::attach(BUS_PIN, t[i]);
+	}
+	PolledOneWire ow(BUS_PIN);
+
+	CHECK(reg.scan(&ow) == 4 && !reg.overflow);
+	CHECK(reg.family_count(0x10) == 2 && reg.family_count(0x28) == 2);
+	for (i = 0; i < 4; i++)
+		CHECK(reg.find(roms[i]) >= 0);
+	CHECK(reg.find(roms[4]) < 0);
+	reg.save(0);
+	CHECK(loaded.load(0) && loaded.count == 4);
+	for (i = 0; i < 4; i++)
+		CHECK(loaded.find(roms[i]) >= 0);
+
+	for (i = 4; i < total; i++)
+		OneWireSim::attach(BUS_PIN, t[i]);
+	CHECK(reg.scan(&ow) == ONEWIRE_REGISTRY_MAX_DEVICES);
+	CHECK(reg.overflow);
+	reg.clear();
+	CHECK(reg.count == 0 && !reg.overflow);
+	for (i = 0; i < total; i++)
+		delete t[i];
+	end_test();
+}
+
+//
+// A rescan flags a device gone and one new, purge() drops the gone one,
+// and a rescan with more devices than fit sets overflow.
+//
+void test_rescan()
+{
+	uint8_t roms[ONEWIRE_REGISTRY_MAX_DEVICES + 2][8];
+	OneWireSimDS18x20 *t[ONEWIRE_REGISTRY_MAX_DEVICES + 2];
+	const uint8_t total = ONEWIRE_REGISTRY_MAX_DEVICES + 2;
+	PolledOneWireRegistry reg;
+
+	begin_test("rescan");
+	for (uint8_t i = 0; i < total; i++) {
+		make_rom(roms[i], i % 2 ? 0x28 : 0x10, i * 8);
+		t[i] = new OneWireSimDS18x20(roms[i]);
+		if (i < 4)
+			OneWireSim::attach(BUS_PIN, t[i]);
+	}
+	PolledOneWire ow(BUS_PIN);
+
+	CHECK(reg.scan(&ow) == 4);
+	t[0]->present = false;
+	OneWireSim::attach(BUS_PIN, t[4]);
+	CHECK(reg.rescan(&ow) == 2);
+	CHECK(reg.flags[reg.find(roms[0])] == ONEWIRE_REGISTRY_MISSING);
+	CHECK(reg.flags[reg.find(roms[4])] == ONEWIRE_REGISTRY_NEW);
+	reg.purge();
+	CHECK(reg.count == 4 && reg.find(roms[0]) < 0);
+
+	// More devices than fit
+	for (uint8_t i = 5; i < total; i++)
+		OneWireSim::attach(BUS_PIN, t[i]);
+	reg.rescan(&ow);
+	CHECK(reg.overflow && reg.count == ONEWIRE_REGISTRY_MAX_DEVICES);
+	for (uint8_t i = 0; i < total; i++)
+		delete t[i];
+	end_test();
+}
+#endif
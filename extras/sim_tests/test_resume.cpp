@@ -0,0 +1,78 @@
+#include "sim_tests.h"
+
+#if ONEWIRE_RESUME
+//
+// Read the DS2408 PIO registers the polled way, returning how long it took.
+//
+static unsigned long read_registers( PolledOneWire &ow, uint8_t *rom, uint8_t *buf, bool *ok )
+{
+	unsigned long start = OneWireSim::now;
+
+	buf[0] = 0xF0;	// Read PIO Registers
+	buf[1] = 0x88;
+	buf[2] = 0;
+	ow.polled_reset();
+	run(ow);
+	ow.polled_select(rom);
+	run(ow);
+	ow.polled_write_bytes(buf, 3);
+	run(ow);
+	ow.polled_read_into(buf + 3, 10);
+	run(ow);
+	*ok = PolledOneWire::check_crc16(buf, 11, buf + 11);
+	return OneWireSim::now - start;
+}
+
+//
+// Resume instead of Match ROM reads the same data in fewer slots, and any
+// Skip ROM or presence-less reset forgets the cached device.
+//
+void test_resume()
+{
+	uint8_t rom1[8], rom2[8], buf[13];
+	unsigned long match, resume;
+	bool ok;
+
+	begin_test("resume");
+	make_rom(rom1, 0x29, 1);
+	make_rom(rom2, 0x29, 2);
+	OneWireSimDS2408 a(rom1), b(rom2);
+	a.pio_input = 0x5A;
+	b.pio_input = 0xA5;
+	OneWireSim::attach(BUS_PIN, &a);
+	OneWireSim::attach(BUS_PIN, &b);
+	PolledOneWire ow(BUS_PIN);
+
+	CHECK(PolledOneWire::resume_supported(0x29));
+	CHECK(!PolledOneWire::resume_supported(0x28));
+	match = read_registers(ow, rom1, buf, &ok);
+	CHECK(ok && buf[3] == 0x5A);
+	resume = read_registers(ow, rom1, buf, &ok);
+	CHECK(ok && buf[3] == 0x5A);
+	CHECK(resume + 4000 < match);	// 8 slots rather than 72, 4.5 ms less
+	match = read_registers(ow, rom2, buf, &ok);
+	CHECK(ok && buf[3] == 0xA5);
+	CHECK(match > resume + 4000);
+
+	// Skip ROM clears every device's RC flag
+	ow.reset();
+	ow.skip();
+	CHECK(read_registers(ow, rom2, buf, &ok) > resume + 4000);
+	CHECK(ok && buf[3] == 0xA5);
+
+	// Both unplugged: no presence clears the cache too
+	read_registers(ow, rom2, buf, &ok);
+	a.present = b.present = false;
+	ow.polled_reset();
+	run(ow);
+	CHECK(!ow.reset_result);
+	a.present = b.present = true;
+	CHECK(read_registers(ow, rom2, buf, &ok) > resume + 4000);
+	CHECK(ok);
+
+	ow.resume_clear();
+	CHECK(read_registers(ow, rom2, buf, &ok) > resume + 4000);
+	CHECK(ok);
+	end_test();
+}
+#endif
@@ -0,0 +1,70 @@
+#include "sim_tests.h"
+#include "PolledDS18x20.h"
+
+//
+// A DS18S20 and two DS18B20s, one of them parasite powered, converted and
+// read in each of the scheduler's modes.
+//
+void test_scheduler()
+{
+	uint8_t roms[3][8];
+	OneWireSimDS18x20 *t[3];
+
+	begin_test("scheduler");
+	for (uint8_t i = 0; i < 3; i++) {
+		make_rom(roms[i], i ? 0x28 : 0x10, i * 16);
+		t[i] = new OneWireSimDS18x20(roms[i], i == 2);
+		t[i]->temperature = (15 + i) * 16 + 5;	// 5/16 shows in the DS18S20's count remain
+		OneWireSim::attach(BUS_PIN, t[i]);
+	}
+	PolledOneWire ow(BUS_PIN);
+	PolledDS18x20 s(&ow);
+	for (uint8_t i = 0; i < 3; i++)
+		CHECK(s.add(roms[i]));
+
+	for (uint8_t mode = ONEWIRE_DS18X20_ALL; mode <= ONEWIRE_DS18X20_EACH; mode++) {
+		s.start(mode);
+		finish(s);
+		for (uint8_t i = 0; i < 3; i++) {
+			CHECK(s.valid[i]);
+			CHECK(s.raw(i) == (15 + i) * 16 + 5);
+		}
+		CHECK(!t[2]->conversion_failed);
+	}
+	for (uint8_t i = 0; i < 3; i++)
+		delete t[i];
+	end_test();
+}
+
+//
+// An externally powered DS18B20 read in full only every fourth cycle.
+//
+void test_partial_reads()
+{
+	uint8_t rom[8];
+	unsigned long start, took[5];
+
+	begin_test("partial");
+	make_rom(rom, 0x28, 16);
+	OneWireSimDS18x20 t(rom);
+	OneWireSim::attach(BUS_PIN, &t);
+	PolledOneWire ow(BUS_PIN);
+
+	PolledDS18x20 f(&ow);
+	f.add(rom);
+	f.wait_ready = true;
+	f.full_read_every = 4;
+	t.conversion_us = 20000;
+	for (uint8_t c = 0; c < 5; c++) {
+		t.temperature = (30 + c) * 16;
+		start = OneWireSim::now;
+		f.start();
+		finish(f);
+		took[c] = OneWireSim::now - start;
+		CHECK(f.valid[0] && f.raw(0) == (30 + c) * 16);
+	}
+	CHECK(f.cycles == 5);
+	// Cycles 0 and 4 read in full, the others save 56 slots less a reset
+	CHECK(took[1] + 2000 < took[0] && took[3] + 2000 < took[4]);
+	end_test();
+}
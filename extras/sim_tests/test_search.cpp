@@ -0,0 +1,145 @@
+#include "sim_tests.h"
+
+#if ONEWIRE_SEARCH
+//
+// The polled search finds the same devices, in the same order, as the
+// blocking one.
+//
+void test_search()
+{
+	uint8_t roms[5][8], found[6][8];
+	OneWireSimDS18x20 *t[4];
+	uint8_t n = 0, i;
+
+	begin_test("search");
+	for (i = 0; i < 4; i++) {
+		make_rom(roms[i], i < 3 ? 0x28 : 0x10, i * 16);
+		t[i] = new OneWireSimDS18x20(roms[i]);
+		OneWireSim::attach(BUS_PIN, t[i]);
+	}
+	make_rom(roms[4], 0x29, 99);
+	OneWireSimDS2408 sw(roms[4]);
+	OneWireSim::attach(BUS_PIN, &sw);
+	PolledOneWire ow(BUS_PIN);
+
+	while (n < 6 && ow.search(found[n])) {
+		CHECK(PolledOneWire::crc8(found[n], 7) == found[n][7]);
+		n++;
+	}
+	CHECK(n == 5);
+	for (i = 0; i < 5; i++) {
+		uint8_t j = 0;
+		while (j < n && memcmp(found[j], roms[i], 8))
+			j++;
+		CHECK(j < n);
+	}
+
+	ow.reset_search();
+	i = 0;
+	for (;;) {
+		ow.polled_search();
+		run(ow);
+		if (!ow.search_result)
+			break;
+		CHECK(i < n && memcmp(ow.readWriteBuffer, found[i], 8) == 0);
+		i++;
+	}
+	CHECK(i == 5);
+
+	// Nobody there
+	for (i = 0; i < 4; i++)
+		t[i]->present = false;
+	sw.present = false;
+	ow.reset_search();
+	CHECK(!ow.search(found[0]));
+	for (i = 0; i < 4; i++)
+		delete t[i];
+	end_test();
+}
+
+//
+// Searches that find only part of the bus: one family, all but one family,
+// and only the sensors in an alarm condition.
+//
+void test_target_search()
+{
+	uint8_t roms[5][8], addr[8];
+	OneWireSimDS18x20 *t[4];
+	uint8_t n;
+
+	begin_test("target");
+	for (uint8_t i = 0; i < 4; i++) {
+		make_rom(roms[i], i < 3 ? 0x28 : 0x10, i * 16);
+		t[i] = new OneWireSimDS18x20(roms[i]);
+		t[i]->temperature = 20 * 16;
+		t[i]->scratchpad[2] = 50;			// TH
+		t[i]->scratchpad[3] = (uint8_t) -40;	// TL
+		OneWireSim::attach(BUS_PIN, t[i]);
+	}
+	make_rom(roms[4], 0x29, 99);
+	OneWireSimDS2408 sw(roms[4]);
+	OneWireSim::attach(BUS_PIN, &sw);
+	PolledOneWire ow(BUS_PIN);
+
+	// Only the DS18B20s
+	ow.target_search(0x28);
+	n = 0;
+	while (ow.search(addr) && addr[0] == 0x28)
+		n++;
+	CHECK(n == 3);
+
+	// The first DS18B20, then everything but the DS18B20s
+	ow.reset_search();
+	n = 0;
+	while (ow.search(addr)) {
+		n++;
+		if (addr[0] == 0x28)
+			ow.family_skip_search();
+	}
+	CHECK(n == 3);
+
+	// Only the sensor in an alarm condition answers a conditional search
+	t[1]->temperature = 100 * 16;
+	convert_all(ow);
+	ow.reset_search();
+	n = 0;
+	while (ow.search(addr, false)) {
+		CHECK(memcmp(addr, roms[1], 8) == 0);
+		n++;
+	}
+	CHECK(n == 1);
+	for (uint8_t i = 0; i < 4; i++)
+		delete t[i];
+	end_test();
+}
+
+//
+// verify() finds a known device, and not one that is gone, and leaves a
+// search in progress alone.
+//
+void test_verify()
+{
+	uint8_t roms[2][8], addr[8];
+	uint8_t n = 1;
+
+	begin_test("verify");
+	make_rom(roms[0], 0x28, 1);
+	make_rom(roms[1], 0x29, 2);
+	OneWireSimDS18x20 t(roms[0]);
+	OneWireSimDS2408 sw(roms[1]);
+	OneWireSim::attach(BUS_PIN, &t);
+	OneWireSim::attach(BUS_PIN, &sw);
+	PolledOneWire ow(BUS_PIN);
+
+	CHECK(ow.search(addr));
+	CHECK(ow.verify(roms[0]));
+	CHECK(ow.verify(roms[1]));
+	while (ow.search(addr))
+		n++;
+	CHECK(n == 2);
+
+	sw.present = false;
+	CHECK(!ow.verify(roms[1]));
+	end_test();
+}
+#endif
@@ -0,0 +1,81 @@
+#include "sim_tests.h"
+#include "PolledOneWireMulti.h"
+
+//
+// The longest interrupts-disabled window of a reset and of each slot, at
+// each speed and with PolledOneWireMulti, as listed at the top of
+// PolledOneWire.cpp. A micros() call inside a window costs
+// OneWireSim::micros_cost.
+//
+static unsigned long window_reset( PolledOneWire &ow )
+{
+	OneWireSim::max_critical = 0;
+	ow.polled_reset();
+	run(ow);
+	CHECK(ow.reset_result);
+	return OneWireSim::max_critical;
+}
+
+static unsigned long window_slots( PolledOneWire &ow, uint8_t v )
+{
+	OneWireSim::max_critical = 0;
+	ow.polled_write(v);
+	run(ow);
+	ow.polled_read();
+	run(ow);
+	return OneWireSim::max_critical;
+}
+
+void test_slots()
+{
+	uint8_t rom[8], roms[2][8];
+	const uint8_t pins[2] = { 8, 9 };
+	unsigned long isr = 0;
+
+#if ONEWIRE_TIMER_POLL
+	// poll() runs in the timer interrupt, so its micros() call before a
+	// slot is inside the window too
+	isr = OneWireSim::micros_cost;
+#endif
+
+	begin_test("slots");
+	make_rom(rom, 0x28, 1);
+	OneWireSimDS18x20 t(rom);
+	t.supports_overdrive = true;
+	OneWireSim::attach(BUS_PIN, &t);
+	PolledOneWire ow(BUS_PIN);
+
+	// Standard speed: the presence sample, and a write-0 slot
+	CHECK(window_reset(ow) == 80 + OneWireSim::micros_cost + isr);
+	CHECK(window_slots(ow, 0xFF) == 13 + isr);
+	CHECK(window_slots(ow, 0x00) == 65 + isr);
+
+	// Overdrive speed: the whole reset pulse and presence sample
+	ow.polled_reset();
+	run(ow);
+	ow.polled_overdrive_skip();
+	run(ow);
+	CHECK(ow.overdrive);
+	CHECK(window_reset(ow) == 78);
+	CHECK(window_slots(ow, 0x00) <= 8);
+
+	// PolledOneWireMulti: the presence sample
+	for (uint8_t i = 0; i < 2; i++)
+		make_rom(roms[i], 0x28, 10 + i);
+	OneWireSimDS18x20 a(roms[0]), b(roms[1]);
+	OneWireSim::attach(pins[0], &a);
+	OneWireSim::attach(pins[1], &b);
+	PolledOneWireMulti m(pins, 2);
+	OneWireSim::max_critical = 0;
+	m.polled_reset();
+	while (m.poll_status)
+		m.poll();
+	CHECK(m.reset_result == 0x03);
+	CHECK(OneWireSim::max_critical == 80);
+	OneWireSim::max_critical = 0;
+	m.polled_write(0x00);
+	while (m.poll_status)
+		m.poll();
+	CHECK(OneWireSim::max_critical <= 65);
+	end_test();
+}
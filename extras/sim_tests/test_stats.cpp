@@ -0,0 +1,45 @@
+#include "sim_tests.h"
+
+#if ONEWIRE_STATS
+//
+// The counters after polled operations, one of them polled late, agree
+// with what the simulator saw.
+//
+void test_stats()
+{
+	uint8_t rom[8], sp[9];
+
+	begin_test("stats");
+	make_rom(rom, 0x28, 1);
+	OneWireSimDS18x20 t(rom);
+	OneWireSim::attach(BUS_PIN, &t);
+	PolledOneWire ow(BUS_PIN);
+
+	ow.stats_clear();
+	ow.polled_reset();
+	run(ow);
+	ow.polled_select(rom);
+	run(ow);
+	CHECK(ow.stats.ops == 2);
+	CHECK(ow.stats.polls >= ow.stats.last_op_polls && ow.stats.last_op_polls > 1);
+	CHECK(ow.stats.max_critical_us > 0);
+	// Timed with micros(), which costs the simulator a little of its own
+	CHECK(ow.stats.max_critical_us <= OneWireSim::max_critical + OneWireSim::micros_cost);
+	CHECK(ow.stats.max_poll_us >= ow.stats.max_critical_us);
+	CHECK(ow.stats.overdue == 0);
+
+	// Between bytes, a poll held up well past its deadline
+	ow.polled_write(0xBE);
+	run(ow);
+	ow.polled_read_into(sp, 1);
+	ow.poll();
+	delayMicroseconds(300);
+	run(ow);
+	CHECK(ow.stats.overdue > 0);
+	CHECK(ow.stats.max_gap_us >= 300);
+
+	ow.stats_clear();
+	CHECK(ow.stats.polls == 0 && ow.stats.ops == 0 && ow.stats.overdue == 0);
+	end_test();
+}
+#endif
@@ -0,0 +1,36 @@
+#include "sim_tests.h"
+
+#if ONEWIRE_TIMER_POLL
+//
+// A whole transaction runs from the timer interrupt while the caller only
+// waits, and the timer stops when it is done.
+//
+void test_timer()
+{
+	uint8_t rom[8], sp[9];
+
+	begin_test("timer");
+	make_rom(rom, 0x28, 1);
+	OneWireSimDS18x20 t(rom);
+	t.temperature = 42 * 16;
+	OneWireSim::attach(BUS_PIN, &t);
+	PolledOneWire ow(BUS_PIN);
+	convert_all(ow);
+
+	ow.queue_clear();
+	ow.queue_reset();
+	ow.queue_select(rom);
+	ow.queue_write_byte(0xBE);
+	ow.queue_read(sp, 9);
+	ow.queue_start();
+	ow.start_timer_poll();
+	CHECK(OneWireSim::timer_armed);
+	delay(50);
+	CHECK(!ow.poll_status);
+	CHECK(ow.queue_result == ONEWIRE_QUEUE_OK);
+	CHECK(PolledOneWire::crc8(sp, 8) == sp[8]);
+	CHECK(temperature(sp) == 42 * 16);
+	CHECK(!OneWireSim::timer_armed);
+	end_test();
+}
+#endif